@@ -0,0 +1,94 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <string_view>
+
+#include "http/http_scan.hpp"
+
+namespace {
+using qabot::http::findColonOrNewline;
+using qabot::http::findNewline;
+using qabot::http::scanImplementation;
+
+// the head of a Gemini streaming response, as the relay reads it
+std::string headerBlock() {
+  return "HTTP/1.1 200 OK\r\n"
+         "Content-Type: text/event-stream\r\n"
+         "Content-Disposition: attachment\r\n"
+         "Vary: Origin\r\n"
+         "Vary: X-Origin\r\n"
+         "Vary: Referer\r\n"
+         "Transfer-Encoding: chunked\r\n"
+         "Date: Fri, 16 Oct 2026 16:43:05 GMT\r\n"
+         "Server: scaffolding on HTTPServer2\r\n"
+         "X-XSS-Protection: 0\r\n"
+         "X-Frame-Options: SAMEORIGIN\r\n"
+         "X-Content-Type-Options: nosniff\r\n"
+         "Server-Timing: gfet4t7; dur=412\r\n"
+         "Alt-Svc: h3=\":443\"; ma=2592000,h3-29=\":443\"; ma=2592000\r\n"
+         "\r\n";
+}
+
+// a run of SSE events, each one data line with a chunk of the answer
+std::string eventStream() {
+  std::string event =
+      R"(data: {"candidates": [{"content": {"parts": [{"text": "Walk the )"
+      R"(list once and flip every next pointer, keeping the previous node )"
+      R"(around."}],"role": "model"},"index": 0}],"usageMetadata": )"
+      R"({"promptTokenCount": 31,"totalTokenCount": 44}})"
+      "\r\n\r\n";
+  std::string stream;
+  while (stream.size() < 64 * 1024) {
+    stream += event;
+  }
+  return stream;
+}
+
+std::string input(int64_t kind) {
+  return kind == 0 ? headerBlock() : eventStream();
+}
+
+// the std::string_view::find the readers used before http_scan
+size_t findNewlineBaseline(std::string_view data, size_t from) {
+  return data.find('\n', from);
+}
+
+size_t findColonOrNewlineBaseline(std::string_view data, size_t from) {
+  for (size_t i = from; i < data.size(); ++i) {
+    if (data[i] == ':' || data[i] == '\n') {
+      return i;
+    }
+  }
+  return std::string_view::npos;
+}
+
+// Walks every delimiter of the input the way a line reader does, one search
+// per line starting after the previous match
+template <size_t (*Find)(std::string_view, size_t)>
+void BM_Scan(benchmark::State &state) {
+  auto data = input(state.range(0));
+  for (auto _ : state) {
+    size_t count = 0;
+    for (auto pos = Find(data, 0); pos != std::string_view::npos;
+         pos = Find(data, pos + 1)) {
+      ++count;
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+  state.SetLabel(state.range(0) == 0 ? "headers" : "sse");
+}
+
+// the two-byte scanner, labelled with the one picked for this CPU
+template <size_t (*Find)(std::string_view, size_t)>
+void BM_ScanDispatch(benchmark::State &state) {
+  BM_Scan<Find>(state);
+  state.SetLabel(std::string(state.range(0) == 0 ? "headers/" : "sse/") +
+                 std::string(scanImplementation()));
+}
+
+BENCHMARK(BM_Scan<findNewlineBaseline>)->Arg(0)->Arg(1);
+BENCHMARK(BM_Scan<findNewline>)->Arg(0)->Arg(1);
+BENCHMARK(BM_Scan<findColonOrNewlineBaseline>)->Arg(0)->Arg(1);
+BENCHMARK(BM_ScanDispatch<findColonOrNewline>)->Arg(0)->Arg(1);
+} // namespace
@@ -0,0 +1,142 @@
+#include <benchmark/benchmark.h>
+
+#include <malloc.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "awaitable/awaitable.hpp"
+#include "buffered_reader/buffered_reader.hpp"
+#include "socket/socket.hpp"
+#include "socket/unix_socket_impl.hpp"
+#include "task/task.hpp"
+#include "write_queue/write_queue.hpp"
+
+namespace {
+using Connection = qabot::socket::Socket<qabot::socket::UnixSocketImpl>;
+using ConnectionPtr = std::shared_ptr<Connection>;
+
+constexpr size_t kConnections = 1000;
+constexpr auto kIdleTimeout = std::chrono::seconds(60);
+
+size_t residentBytes() {
+  std::ifstream statm("/proc/self/statm");
+  size_t size = 0;
+  size_t resident = 0;
+  statm >> size >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+void finish(std::atomic_size_t &finished) {
+  finished.fetch_add(1);
+  finished.notify_one();
+}
+
+// A client session the way _clientLoop reads it: a BufferedReader that
+// borrows from the BufferPool only while it has unread bytes
+qabot::task::DetachedTask pooledSession(ConnectionPtr connection,
+                                        std::atomic_size_t &finished) {
+  using Reader = qabot::buffered_reader::BufferedReader<Connection>;
+  Reader reader(*connection, Reader::kDefaultCapacity, 1024 * 1024);
+  qabot::write_queue::WriteQueue writer(*connection);
+  while (true) {
+    auto deadline = qabot::reactor::Clock::now() + kIdleTimeout;
+    if (co_await reader.fill(deadline) == 0) {
+      break;
+    }
+    co_await writer.asyncWriteAll(reader.buffered());
+    reader.consume(reader.buffered().size());
+  }
+  finish(finished);
+}
+
+// the same session with the 16 KB buffer every connection kept for its whole
+// lifetime before the pool
+qabot::task::DetachedTask ownedBufferSession(ConnectionPtr connection,
+                                             std::atomic_size_t &finished) {
+  std::vector<char> buffer(16 * 1024);
+  qabot::write_queue::WriteQueue writer(*connection);
+  while (true) {
+    auto deadline = qabot::reactor::Clock::now() + kIdleTimeout;
+    size_t bytesReceived = co_await qabot::awaitable::Awaitable(
+        connection->getSocketFD(),
+        [&]() {
+          return connection->receiveSome(buffer.data(), buffer.size());
+        },
+        deadline);
+    if (bytesReceived == 0) {
+      break;
+    }
+    co_await writer.asyncWriteAll(
+        std::string_view(buffer.data(), bytesReceived));
+  }
+  finish(finished);
+}
+
+// Opens kConnections connections, sends a request of the size of a chat
+// request over each and waits for its echo, then measures how much resident
+// memory the connections hold while they wait for their next request
+template <qabot::task::DetachedTask (*Session)(ConnectionPtr,
+                                               std::atomic_size_t &)>
+void BM_IdleConnections(benchmark::State &state) {
+  const std::string request(512, 'x');
+  for (auto _ : state) {
+    malloc_trim(0);
+    auto before = residentBytes();
+
+    std::atomic_size_t finished{0};
+    std::vector<int> peers;
+    for (size_t i = 0; i < kConnections; ++i) {
+      int fds[2];
+      if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        state.SkipWithError("socketpair failed");
+        return;
+      }
+      qabot::socket::UnixSocketImpl impl(fds[0],
+                                         qabot::socket::TransportProtocol::TCP,
+                                         qabot::socket::IPVersion::IPv4);
+      Session(std::make_shared<Connection>(impl), finished);
+      peers.push_back(fds[1]);
+    }
+    for (int peer : peers) {
+      ::send(peer, request.data(), request.size(), 0);
+      std::string reply(request.size(), '\0');
+      for (size_t received = 0; received < reply.size();) {
+        auto bytes = ::recv(peer, reply.data() + received,
+                            reply.size() - received, 0);
+        if (bytes <= 0) {
+          state.SkipWithError("echo failed");
+          return;
+        }
+        received += bytes;
+      }
+    }
+    // a session answers before it goes back to waiting
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    state.counters["rss_kib_per_1k"] =
+        static_cast<double>(residentBytes() - before) / 1024 *
+        (1000.0 / kConnections);
+
+    for (int peer : peers) {
+      ::close(peer);
+    }
+    for (auto done = finished.load(); done < kConnections;
+         done = finished.load()) {
+      finished.wait(done);
+    }
+  }
+}
+
+BENCHMARK(BM_IdleConnections<ownedBufferSession>)
+    ->Iterations(1)
+    ->UseRealTime();
+BENCHMARK(BM_IdleConnections<pooledSession>)->Iterations(1)->UseRealTime();
+} // namespace
@@ -0,0 +1,36 @@
+#include <benchmark/benchmark.h>
+
+#include "mpmc_queue/mpmc_queue.hpp"
+#include "thread_safe_queue/thread_safe_queue.hpp"
+
+namespace {
+using qabot::mpmc_queue::MpmcQueue;
+using qabot::thread_safe_queue::ThreadSafeQueue;
+
+// one queue shared by all threads of a run, like the event loop's
+template <typename Queue> Queue &sharedQueue() {
+  static Queue queue;
+  return queue;
+}
+
+// Every thread pushes one item and pops one, so producers and consumers
+// fight over the same queue the way the workers do
+template <typename Queue> void BM_PushPop(benchmark::State &state) {
+  auto &queue = sharedQueue<Queue>();
+  size_t item = 0;
+  for (auto _ : state) {
+    queue.push(item++);
+    // a pop can miss an item whose producer hasn't published yet
+    std::optional<size_t> popped;
+    while (!(popped = queue.tryPop())) {
+    }
+    benchmark::DoNotOptimize(popped);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_PushPop<ThreadSafeQueue<size_t>>)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK(BM_PushPop<MpmcQueue<size_t>>)->ThreadRange(1, 64)->UseRealTime();
+} // namespace
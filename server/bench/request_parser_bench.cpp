@@ -0,0 +1,136 @@
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "http/http.hpp"
+#include "http/request_parser.hpp"
+
+namespace {
+using qabot::http::HttpRequest;
+using qabot::http::RequestMethod;
+using qabot::http::RequestParser;
+
+// The stringstream parser the server used before RequestParser, kept here
+// as the baseline to compare against
+HttpRequest baselineParseRequest(const std::string &rawHttp) {
+  std::stringstream requestStream(rawHttp);
+  std::string line;
+
+  std::getline(requestStream, line);
+  std::stringstream lineStream(line);
+  std::unordered_map<std::string, std::string> headers;
+  std::string method, path, version;
+  lineStream >> method >> path >> version;
+  if (method != "POST" && method != "GET") {
+    throw std::runtime_error("Unsupported HTTP method");
+  }
+
+  while (getline(requestStream, line)) {
+    std::stringstream lineStream(line);
+    std::string key;
+    std::string value;
+    lineStream >> key >> value;
+    if (line == "\r") {
+      break;
+    }
+    if (key.empty() || value.empty()) {
+      continue;
+    }
+    if (key.back() == ':') {
+      key.pop_back();
+    }
+    if (value.back() == '\r') {
+      value.pop_back();
+    }
+    headers[key] = value;
+  }
+
+  std::string body = requestStream.str().substr(requestStream.tellg());
+  return HttpRequest{method == "POST" ? RequestMethod::Post
+                                      : RequestMethod::Get,
+                     path, headers, body};
+}
+
+// a chat request the way a browser sends it, with a history of turns
+std::string chatRequest(size_t turns) {
+  std::string body = R"({"model_name":"gemini-2.0-flash","prompt":"You )"
+                     R"(are a helpful assistant.","context":[)";
+  for (size_t i = 0; i < turns; ++i) {
+    body += i ? "," : "";
+    body += R"({"user":"How do I reverse a linked list in C++?"},)"
+            R"({"model":"Walk the list once and flip every next pointer."})";
+  }
+  body += R"(],"message":"And in place?"})";
+  return "POST /chat HTTP/1.1\r\n"
+         "Host: localhost:38763\r\n"
+         "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) "
+         "Gecko/20100101 Firefox/128.0\r\n"
+         "Accept: text/event-stream\r\n"
+         "Accept-Language: en-US,en;q=0.5\r\n"
+         "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+         "Content-Type: application/json\r\n"
+         "Origin: http://localhost:5173\r\n"
+         "Connection: keep-alive\r\n"
+         "Content-Length: " +
+         std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+void BM_BaselineParseRequest(benchmark::State &state) {
+  auto request = chatRequest(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(baselineParseRequest(request));
+  }
+  state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(BM_BaselineParseRequest)->Arg(0)->Arg(10);
+
+void BM_RequestParser(benchmark::State &state) {
+  auto request = chatRequest(state.range(0));
+  RequestParser parser;
+  for (auto _ : state) {
+    parser.reset();
+    benchmark::DoNotOptimize(parser.parse(request));
+  }
+  state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(BM_RequestParser)->Arg(0)->Arg(10);
+
+// the request arrives in packets of 1400 bytes and is parsed after each
+void BM_RequestParserIncremental(benchmark::State &state) {
+  auto request = chatRequest(state.range(0));
+  std::string_view data(request);
+  RequestParser parser;
+  for (auto _ : state) {
+    parser.reset();
+    for (size_t size = 1400; size < data.size(); size += 1400) {
+      benchmark::DoNotOptimize(parser.parse(data.substr(0, size)));
+    }
+    benchmark::DoNotOptimize(parser.parse(data));
+  }
+  state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(BM_RequestParserIncremental)->Arg(10);
+
+// eight requests pipelined in one buffer
+void BM_RequestParserPipelined(benchmark::State &state) {
+  std::string requests;
+  for (int i = 0; i < 8; ++i) {
+    requests += chatRequest(0);
+  }
+  RequestParser parser;
+  for (auto _ : state) {
+    std::string_view data(requests);
+    while (!data.empty()) {
+      parser.reset();
+      parser.parse(data);
+      data.remove_prefix(parser.messageSize());
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * requests.size());
+}
+BENCHMARK(BM_RequestParserPipelined);
+} // namespace
@@ -0,0 +1,312 @@
+#include <benchmark/benchmark.h>
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffered_reader/buffered_reader.hpp"
+#include "socket/socket.hpp"
+#include "socket/unix_socket_impl.hpp"
+#include "task/task.hpp"
+#include "write_queue/write_queue.hpp"
+#ifdef QABOT_IO_URING
+#include "socket/uring_socket_impl.hpp"
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// about the size of one relayed SSE token
+constexpr size_t kChunkSize = 96;
+
+void finish(std::atomic_size_t &finished) {
+  finished.fetch_add(1);
+  finished.notify_one();
+}
+
+// echoes every chunk the way _clientLoop relays one: read into the pooled
+// BufferedReader, written back through the WriteQueue
+template <typename Impl>
+qabot::task::DetachedTask
+echoSession(std::shared_ptr<qabot::socket::Socket<Impl>> connection,
+            std::atomic_size_t &finished) {
+  using Reader = qabot::buffered_reader::BufferedReader<
+      qabot::socket::Socket<Impl>>;
+  Reader reader(*connection, Reader::kDefaultCapacity, 1024 * 1024);
+  qabot::write_queue::WriteQueue writer(*connection);
+  try {
+    while (co_await reader.fill() > 0) {
+      co_await writer.asyncWriteAll(reader.buffered());
+      reader.consume(reader.buffered().size());
+    }
+  } catch (const std::exception &) {
+  }
+  finish(finished);
+}
+
+// Counts the syscalls of every thread in the process but the calling one,
+// through the raw_syscalls:sys_enter tracepoint. That is the server side of
+// the benchmark: workers, reactor and io_uring completion thread. Needs
+// tracefs and perf access, isAvailable() is false without them.
+class SyscallCounter {
+public:
+  SyscallCounter() {
+    const auto tracepoint = _tracepointId();
+    if (!tracepoint) {
+      return;
+    }
+    perf_event_attr attributes{};
+    attributes.type = PERF_TYPE_TRACEPOINT;
+    attributes.size = sizeof(attributes);
+    attributes.config = *tracepoint;
+    attributes.disabled = 1;
+    const auto self = static_cast<pid_t>(::syscall(SYS_gettid));
+    auto *tasks = opendir("/proc/self/task");
+    if (tasks == nullptr) {
+      return;
+    }
+    bool isComplete = true;
+    while (auto *task = readdir(tasks)) {
+      const auto thread = static_cast<pid_t>(std::atoi(task->d_name));
+      if (thread <= 0 || thread == self) {
+        continue;
+      }
+      int fd = static_cast<int>(
+          ::syscall(SYS_perf_event_open, &attributes, thread, -1, -1, 0));
+      if (fd < 0) {
+        isComplete = false;
+        break;
+      }
+      _events.push_back(fd);
+    }
+    closedir(tasks);
+    if (!isComplete) {
+      _close();
+    }
+  }
+
+  ~SyscallCounter() { _close(); }
+
+  SyscallCounter(const SyscallCounter &) = delete;
+  SyscallCounter &operator=(const SyscallCounter &) = delete;
+
+  bool isAvailable() const { return !_events.empty(); }
+
+  void start() {
+    for (int fd : _events) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  // syscalls since start()
+  uint64_t stop() {
+    uint64_t total = 0;
+    for (int fd : _events) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t count = 0;
+      if (::read(fd, &count, sizeof(count)) == sizeof(count)) {
+        total += count;
+      }
+    }
+    return total;
+  }
+
+private:
+  static std::optional<uint64_t> _tracepointId() {
+    for (const char *path :
+         {"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+          "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"}) {
+      uint64_t id = 0;
+      if (std::ifstream(path) >> id) {
+        return id;
+      }
+    }
+    return std::nullopt;
+  }
+
+  void _close() {
+    for (int fd : _events) {
+      ::close(fd);
+    }
+    _events.clear();
+  }
+
+  std::vector<int> _events;
+};
+
+// every connection takes a descriptor on each side
+bool raiseDescriptorLimit(size_t connections) {
+  const rlim_t needed = 2 * connections + 64;
+  rlimit limit{};
+  getrlimit(RLIMIT_NOFILE, &limit);
+  if (limit.rlim_cur >= needed) {
+    return true;
+  }
+  limit.rlim_cur = needed;
+  limit.rlim_max = std::max(limit.rlim_max, needed);
+  return setrlimit(RLIMIT_NOFILE, &limit) == 0;
+}
+
+int connectTo(int port) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                sizeof(address)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+// A chunk is written to every connection at once and each one waits for its
+// echo, the way a burst of upstream tokens fans out to the clients. Reports
+// the round trips per second, their p99 latency and the server's syscalls
+// per chunk echoed.
+template <typename Impl> void BM_StreamChunks(benchmark::State &state) {
+  using Connection = qabot::socket::Socket<Impl>;
+  const auto connections = static_cast<size_t>(state.range(0));
+  if (!raiseDescriptorLimit(connections)) {
+    state.SkipWithError("RLIMIT_NOFILE too low for the connections");
+    return;
+  }
+
+  Connection listener(qabot::socket::TransportProtocol::TCP,
+                      qabot::socket::IPVersion::IPv4);
+  listener.bind("127.0.0.1", 0);
+  listener.listen(static_cast<int>(connections));
+  sockaddr_in bound{};
+  socklen_t boundLength = sizeof(bound);
+  getsockname(listener.getSocketFD(), reinterpret_cast<sockaddr *>(&bound),
+              &boundLength);
+
+  std::atomic_size_t finished{0};
+  std::vector<pollfd> peers;
+  for (size_t i = 0; i < connections; ++i) {
+    int peer = connectTo(ntohs(bound.sin_port));
+    if (peer < 0) {
+      state.SkipWithError("connect failed");
+      return;
+    }
+    peers.push_back({peer, POLLIN, 0});
+    // accept is non-blocking here, the connection is already queued
+    while (true) {
+      if (auto client = listener.accept()) {
+        echoSession<Impl>(std::make_shared<Connection>(std::move(*client)),
+                          finished);
+        break;
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  const std::string chunk(kChunkSize, 'x');
+  std::vector<char> reply(kChunkSize);
+  std::vector<size_t> received(connections);
+  auto roundTrip = [&](std::vector<Clock::duration> &latencies) {
+    const auto sent = Clock::now();
+    for (auto &peer : peers) {
+      ::send(peer.fd, chunk.data(), chunk.size(), MSG_NOSIGNAL);
+    }
+    std::fill(received.begin(), received.end(), 0);
+    for (size_t done = 0; done < connections;) {
+      ::poll(peers.data(), peers.size(), -1);
+      for (size_t i = 0; i < connections; ++i) {
+        if (!(peers[i].revents & POLLIN) || received[i] == kChunkSize) {
+          continue;
+        }
+        auto bytes = ::recv(peers[i].fd, reply.data(),
+                            kChunkSize - received[i], MSG_DONTWAIT);
+        if (bytes <= 0) {
+          continue;
+        }
+        received[i] += bytes;
+        if (received[i] == kChunkSize) {
+          latencies.push_back(Clock::now() - sent);
+          ++done;
+        }
+      }
+    }
+  };
+
+  // an untimed round first, the server's threads only exist once a
+  // session was resumed and the counter has to see them
+  std::vector<Clock::duration> latencies;
+  roundTrip(latencies);
+  latencies.clear();
+  SyscallCounter syscalls;
+  syscalls.start();
+  for (auto _ : state) {
+    roundTrip(latencies);
+  }
+  const auto serverSyscalls = syscalls.stop();
+
+  std::sort(latencies.begin(), latencies.end());
+  auto p99 = latencies[latencies.size() * 99 / 100];
+  state.counters["p99_us"] =
+      std::chrono::duration<double, std::micro>(p99).count();
+  if (syscalls.isAvailable()) {
+    state.counters["syscalls_per_chunk"] =
+        static_cast<double>(serverSyscalls) /
+        static_cast<double>(state.iterations() * connections);
+  } else {
+    state.SetLabel("no syscall tracepoint");
+  }
+  state.SetItemsProcessed(state.iterations() * connections);
+  state.SetBytesProcessed(state.iterations() * connections * kChunkSize);
+
+  for (auto &peer : peers) {
+    ::close(peer.fd);
+  }
+  for (auto done = finished.load(); done < connections;
+       done = finished.load()) {
+    finished.wait(done);
+  }
+}
+
+BENCHMARK(BM_StreamChunks<qabot::socket::UnixSocketImpl>)
+    ->Arg(16)
+    ->Arg(256)
+    ->UseRealTime();
+// 10k connections take a while to set up and leave as many ports in
+// TIME_WAIT, so they run once with a fixed number of rounds
+BENCHMARK(BM_StreamChunks<qabot::socket::UnixSocketImpl>)
+    ->Arg(10000)
+    ->Iterations(50)
+    ->UseRealTime();
+#ifdef QABOT_IO_URING
+BENCHMARK(BM_StreamChunks<qabot::socket::UringSocketImpl>)
+    ->Arg(16)
+    ->Arg(256)
+    ->UseRealTime();
+BENCHMARK(BM_StreamChunks<qabot::socket::UringSocketImpl>)
+    ->Arg(10000)
+    ->Iterations(50)
+    ->UseRealTime();
+#endif
+} // namespace
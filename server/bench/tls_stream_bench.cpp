@@ -0,0 +1,203 @@
+#include <benchmark/benchmark.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics/metrics.hpp"
+#include "socket/io_error.hpp"
+#include "socket/secure_socket.hpp"
+#include "socket/tls_context.hpp"
+#include "socket/unix_socket_impl.hpp"
+
+namespace {
+using TlsStream = qabot::socket::SecureSocket<qabot::socket::UnixSocketImpl>;
+
+// plaintext streamed per iteration, and per record the server writes
+constexpr size_t kStreamedPerIteration = 1024 * 1024;
+constexpr size_t kRecordSize = 16 * 1024;
+
+// a self-signed P-256 certificate for localhost and its key
+class SelfSignedCertificate {
+public:
+  SelfSignedCertificate() {
+    _key = EVP_EC_gen("P-256");
+    _certificate = X509_new();
+    X509_set_version(_certificate, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(_certificate), 1);
+    X509_gmtime_adj(X509_getm_notBefore(_certificate), 0);
+    X509_gmtime_adj(X509_getm_notAfter(_certificate), 24 * 60 * 60);
+    X509_set_pubkey(_certificate, _key);
+    auto *name = X509_get_subject_name(_certificate);
+    X509_NAME_add_entry_by_txt(
+        name, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(_certificate, name);
+    X509_sign(_certificate, _key, EVP_sha256());
+  }
+
+  ~SelfSignedCertificate() {
+    X509_free(_certificate);
+    EVP_PKEY_free(_key);
+  }
+
+  SelfSignedCertificate(const SelfSignedCertificate &) = delete;
+  SelfSignedCertificate &operator=(const SelfSignedCertificate &) = delete;
+
+  EVP_PKEY *key() const { return _key; }
+  X509 *certificate() const { return _certificate; }
+
+private:
+  EVP_PKEY *_key = nullptr;
+  X509 *_certificate = nullptr;
+};
+
+// A userspace TLS server on loopback. It accepts one client and writes
+// records to it until the client goes away.
+class StreamingServer {
+public:
+  StreamingServer() {
+    static const SelfSignedCertificate certificate;
+    _context = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_use_certificate(_context, certificate.certificate());
+    SSL_CTX_use_PrivateKey(_context, certificate.key());
+
+    _listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    ::bind(_listener, reinterpret_cast<sockaddr *>(&address), length);
+    ::listen(_listener, 1);
+    getsockname(_listener, reinterpret_cast<sockaddr *>(&address), &length);
+    _port = ntohs(address.sin_port);
+
+    _thread = std::thread([this] { _serve(); });
+  }
+
+  ~StreamingServer() {
+    // wakes the accept if the client never came
+    ::shutdown(_listener, SHUT_RDWR);
+    _thread.join();
+    ::close(_listener);
+    SSL_CTX_free(_context);
+  }
+
+  StreamingServer(const StreamingServer &) = delete;
+  StreamingServer &operator=(const StreamingServer &) = delete;
+
+  int port() const { return _port; }
+
+private:
+  void _serve() {
+    int client = ::accept(_listener, nullptr, nullptr);
+    if (client < 0) {
+      return;
+    }
+    auto *ssl = SSL_new(_context);
+    SSL_set_fd(ssl, client);
+    if (SSL_accept(ssl) == 1) {
+      const std::string record(kRecordSize, 'x');
+      while (SSL_write(ssl, record.data(), static_cast<int>(record.size())) >
+             0) {
+      }
+    }
+    SSL_free(ssl);
+    ::close(client);
+  }
+
+  SSL_CTX *_context = nullptr;
+  int _listener = -1;
+  int _port = 0;
+  std::thread _thread;
+};
+
+void waitFor(const TlsStream &stream, qabot::socket::IoErrc wouldBlock) {
+  pollfd pollFd{stream.getSocketFD(),
+                wouldBlock == qabot::socket::IoErrc::WantWrite
+                    ? short{POLLOUT}
+                    : short{POLLIN},
+                0};
+  ::poll(&pollFd, 1, -1);
+}
+
+double threadCpuSeconds() {
+  timespec now{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Streams kStreamedPerIteration bytes per iteration from the server through
+// a SecureSocket and reports the CPU the reading thread spent per MB,
+// decryption in the kernel included. kernel_tls tells whether OpenSSL
+// actually handed the receive direction to the kernel, without the tls
+// module the session stays in userspace.
+void streamTls(benchmark::State &state, bool isKernelTls) {
+  // the server's writes to a closed client must not kill the process
+  std::signal(SIGPIPE, SIG_IGN);
+  qabot::socket::TlsContext::setKernelTls(isKernelTls);
+  auto &kernelReceives = qabot::metrics::Metrics::getInstance().counter(
+      "qabot_tls_ktls_receive_sessions_total");
+  auto kernelReceivesBefore = kernelReceives.load();
+
+  StreamingServer server;
+  TlsStream stream(qabot::socket::TransportProtocol::TCP,
+                   qabot::socket::IPVersion::IPv4);
+  for (auto connected = stream.connect("127.0.0.1", server.port());
+       !connected; connected = stream.connect("127.0.0.1", server.port())) {
+    waitFor(stream, connected.error());
+  }
+
+  std::vector<char> buffer(kRecordSize);
+  bool isClosed = false;
+  const auto cpuBefore = threadCpuSeconds();
+  for (auto _ : state) {
+    for (size_t streamed = 0; streamed < kStreamedPerIteration;) {
+      auto received = stream.receiveSome(buffer.data(), buffer.size());
+      if (!received) {
+        waitFor(stream, received.error());
+        continue;
+      }
+      if (*received == 0) {
+        isClosed = true;
+        break;
+      }
+      streamed += *received;
+    }
+    if (isClosed) {
+      state.SkipWithError("server closed the stream");
+      break;
+    }
+  }
+  const auto cpuSeconds = threadCpuSeconds() - cpuBefore;
+
+  const double megabytes =
+      static_cast<double>(state.iterations() * kStreamedPerIteration) / 1e6;
+  state.counters["cpu_us_per_mb"] = cpuSeconds * 1e6 / megabytes;
+  state.counters["kernel_tls"] =
+      static_cast<double>(kernelReceives.load() - kernelReceivesBefore);
+  state.SetBytesProcessed(state.iterations() * kStreamedPerIteration);
+  qabot::socket::TlsContext::setKernelTls(false);
+}
+
+// records decrypted by OpenSSL out of the memory BIOs
+void BM_TlsStreamUserspace(benchmark::State &state) {
+  streamTls(state, false);
+}
+BENCHMARK(BM_TlsStreamUserspace)->UseRealTime();
+
+// OpenSSL owns the socket and hands the records to the kernel where it can
+void BM_TlsStreamKernel(benchmark::State &state) { streamTls(state, true); }
+BENCHMARK(BM_TlsStreamKernel)->UseRealTime();
+} // namespace
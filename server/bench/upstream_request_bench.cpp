@@ -0,0 +1,149 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+#include "arena/arena.hpp"
+#include "chat_request/chat_request.hpp"
+#include "http/message_template.hpp"
+#include "json_reader/json_reader.hpp"
+#include "metrics/metrics.hpp"
+#include "nlohmann/json.hpp"
+
+namespace {
+using qabot::chat_request::parseChatRequest;
+using qabot::chat_request::writeUpstreamBody;
+
+// new and delete that counts the allocations reaching it
+class CountingResource : public std::pmr::memory_resource {
+public:
+  size_t allocations = 0;
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// a chat request body the way the web client sends it
+std::string chatBody(size_t turns) {
+  std::string body = R"({"model_name":"gemini-2.0-flash","prompt":"You )"
+                     R"(are a helpful assistant.","context":[)";
+  for (size_t i = 0; i < turns; ++i) {
+    body += i ? "," : "";
+    body += R"({"user":"How do I reverse a linked list in C++?"},)"
+            R"({"model":"Walk the list once and flip every next pointer, )"
+            R"(keeping the \"previous\" node around."})";
+  }
+  body += R"(],"message":"And in place?"})";
+  return body;
+}
+
+const qabot::http::MessageTemplate &upstreamRequestTemplate() {
+  static const qabot::http::MessageTemplate instance({
+      "POST https://generativelanguage.googleapis.com/v1beta/models/",
+      ":streamGenerateContent?alt=sse&key=0123456789abcdef HTTP/1.1\r\n"
+      "Host: generativelanguage.googleapis.com\r\n"
+      "Content-Type: application/json\r\n",
+  });
+  return instance;
+}
+
+// builds the upstream request for body the way _clientLoop does, with every
+// allocation going to resource
+void buildUpstreamRequest(std::string_view body,
+                          std::pmr::memory_resource *resource) {
+  auto chat = parseChatRequest(body, resource);
+  std::pmr::string modelName(resource);
+  qabot::json_reader::appendUnescaped(modelName, chat.modelName);
+  std::pmr::string upstreamBody(resource);
+  upstreamBody.reserve(body.size() + 256);
+  writeUpstreamBody(upstreamBody, chat);
+  std::pmr::string request(resource);
+  upstreamRequestTemplate().render(request, {modelName}, upstreamBody);
+  benchmark::DoNotOptimize(request.data());
+}
+
+// every allocation of a request straight from the heap
+void BM_BuildUpstreamRequestHeap(benchmark::State &state) {
+  auto body = chatBody(state.range(0));
+  CountingResource heap;
+  for (auto _ : state) {
+    buildUpstreamRequest(body, &heap);
+  }
+  state.counters["mallocs_per_request"] =
+      benchmark::Counter(static_cast<double>(heap.allocations),
+                         benchmark::Counter::kAvgIterations);
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_BuildUpstreamRequestHeap)->Arg(0)->Arg(10)->Arg(100);
+
+// the per-request arena, only blocks past its pooled first one reach malloc
+void BM_BuildUpstreamRequestArena(benchmark::State &state) {
+  auto body = chatBody(state.range(0));
+  auto &overflows = qabot::metrics::Metrics::getInstance().counter(
+      "qabot_request_arena_overflows_total");
+  auto overflowsBefore = overflows.load();
+  for (auto _ : state) {
+    qabot::arena::RequestArena arena;
+    buildUpstreamRequest(body, arena.resource());
+  }
+  state.counters["mallocs_per_request"] = benchmark::Counter(
+      static_cast<double>(overflows.load() - overflowsBefore),
+      benchmark::Counter::kAvgIterations);
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_BuildUpstreamRequestArena)->Arg(0)->Arg(10)->Arg(100);
+
+// The upstream body the way it was built before JsonWriter: the client's body
+// parsed into a DOM, a second DOM built from it and dumped
+void BM_UpstreamBodyDom(benchmark::State &state) {
+  auto body = chatBody(state.range(0));
+  for (auto _ : state) {
+    auto jsonMessage = nlohmann::json::parse(body);
+    nlohmann::json contentArray = nlohmann::json::array();
+    for (const auto &context : jsonMessage["context"]) {
+      for (const auto &[role, text] : context.items()) {
+        contentArray.push_back(
+            {{"role", role}, {"parts", {{{"text", text}}}}});
+      }
+    }
+    contentArray.push_back(
+        {{"role", "user"}, {"parts", {{{"text", jsonMessage["message"]}}}}});
+    nlohmann::json requestJson = {
+        {"system_instruction",
+         {{"parts", {{{"text", jsonMessage["prompt"]}}}}}},
+        {"contents", contentArray}};
+    benchmark::DoNotOptimize(requestJson.dump());
+  }
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_UpstreamBodyDom)->Arg(1)->Arg(50)->Arg(500);
+
+// JsonReader views of the client's body copied into the upstream body by
+// JsonWriter
+void BM_UpstreamBodyWriter(benchmark::State &state) {
+  auto body = chatBody(state.range(0));
+  std::pmr::string upstreamBody;
+  for (auto _ : state) {
+    upstreamBody.clear();
+    auto chat = parseChatRequest(body, std::pmr::get_default_resource());
+    writeUpstreamBody(upstreamBody, chat);
+    benchmark::DoNotOptimize(upstreamBody.data());
+  }
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_UpstreamBodyWriter)->Arg(1)->Arg(50)->Arg(500);
+} // namespace
@@ -0,0 +1,80 @@
+#include <benchmark/benchmark.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <optional>
+#include <system_error>
+
+#include "reactor/reactor.hpp"
+#include "socket/io_error.hpp"
+#include "socket/socket.hpp"
+#include "socket/unix_socket_impl.hpp"
+
+namespace {
+using qabot::reactor::Interest;
+using qabot::socket::IoErrc;
+
+// a connection nothing is sent on, the socket end belongs to whoever reads
+// from it
+class EmptySocketPair {
+public:
+  EmptySocketPair() { ::socketpair(AF_UNIX, SOCK_STREAM, 0, _fds); }
+  ~EmptySocketPair() { ::close(_fds[1]); }
+
+  int socketFD() const { return _fds[0]; }
+
+private:
+  int _fds[2] = {-1, -1};
+};
+
+// A receive on an empty socket the way Awaitable sees it now: the
+// would-block comes back as the IoResult's error
+void BM_WouldBlockResult(benchmark::State &state) {
+  EmptySocketPair pair;
+  qabot::socket::UnixSocketImpl impl(pair.socketFD(),
+                                     qabot::socket::TransportProtocol::TCP,
+                                     qabot::socket::IPVersion::IPv4);
+  qabot::socket::Socket<qabot::socket::UnixSocketImpl> socket(impl);
+  char buffer[512];
+  for (auto _ : state) {
+    auto received = socket.receiveSome(buffer, sizeof(buffer));
+    auto interest = received ? std::nullopt
+                    : received.error() == IoErrc::WantWrite
+                        ? std::optional(Interest::Write)
+                        : std::optional(Interest::Read);
+    benchmark::DoNotOptimize(interest);
+  }
+}
+BENCHMARK(BM_WouldBlockResult);
+
+// The same receive the way it was before IoResult: EAGAIN thrown as a
+// system_error, caught by Awaitable and matched to the readiness to wait for
+void BM_WouldBlockThrow(benchmark::State &state) {
+  EmptySocketPair pair;
+  char buffer[512];
+  for (auto _ : state) {
+    std::optional<Interest> interest;
+    try {
+      auto bytes = ::recv(pair.socketFD(), buffer, sizeof(buffer),
+                          MSG_DONTWAIT);
+      if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        throw std::system_error(make_error_code(IoErrc::WantRead),
+                                "Failed to receive message");
+      }
+    } catch (const std::system_error &e) {
+      if (e.code() == IoErrc::WantRead) {
+        interest = Interest::Read;
+      } else if (e.code() == IoErrc::WantWrite) {
+        interest = Interest::Write;
+      } else if (e.code() == std::errc::operation_would_block) {
+        interest = Interest::Read;
+      }
+    }
+    benchmark::DoNotOptimize(interest);
+  }
+  ::close(pair.socketFD());
+}
+BENCHMARK(BM_WouldBlockThrow);
+} // namespace
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+#include "buffer_pool/buffer_pool.hpp"
+#include "metrics/metrics.hpp"
+
+namespace qabot::arena {
+// Memory for everything one request builds on its way upstream. Allocations
+// only bump a pointer, deallocations are no-ops, and the whole arena is
+// released at once when it goes out of scope at the end of the request.
+//
+// The first block is a pooled buffer, so a typical request never calls
+// malloc at all. Bigger requests continue in blocks from the heap, counted in
+// qabot_request_arena_overflows_total to show when kInitialSize is too small.
+class RequestArena {
+public:
+  static constexpr size_t kInitialSize =
+      buffer_pool::BufferPool::kSizeClasses[1];
+
+  RequestArena()
+      : _initialBlock(
+            buffer_pool::BufferPool::getInstance().acquire(kInitialSize)),
+        _resource(_initialBlock.data(), _initialBlock.size(),
+                  &_OverflowResource::getInstance()) {}
+
+  // the resource points into the arena itself
+  RequestArena(const RequestArena &) = delete;
+  RequestArena &operator=(const RequestArena &) = delete;
+  RequestArena(RequestArena &&) = delete;
+  RequestArena &operator=(RequestArena &&) = delete;
+
+  std::pmr::memory_resource *resource() { return &_resource; }
+
+  template <typename T = std::byte>
+  std::pmr::polymorphic_allocator<T> allocator() {
+    return std::pmr::polymorphic_allocator<T>(&_resource);
+  }
+
+private:
+  // new/delete that counts how often an arena outgrew its first block
+  class _OverflowResource : public std::pmr::memory_resource {
+  public:
+    static _OverflowResource &getInstance() {
+      static _OverflowResource instance;
+      return instance;
+    }
+
+  private:
+    _OverflowResource()
+        : _overflows(metrics::Metrics::getInstance().counter(
+              "qabot_request_arena_overflows_total")) {}
+
+    void *do_allocate(size_t bytes, size_t alignment) override {
+      _overflows.fetch_add(1, std::memory_order_relaxed);
+      return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+      std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(
+        const std::pmr::memory_resource &other) const noexcept override {
+      return this == &other;
+    }
+
+    std::atomic_int64_t &_overflows;
+  };
+
+  buffer_pool::BufferPool::Buffer _initialBlock;
+  std::pmr::monotonic_buffer_resource _resource;
+};
+} // namespace qabot::arena
@@ -1,217 +1,283 @@
 #pragma once
 #include "event_manager/event_manager.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <coroutine>
 #include <exception>
-#include <functional>
+#include <optional>
 #include <type_traits>
 
+#include "reactor/reactor.hpp"
+#include "socket/io_error.hpp"
 #include "socket/socket.hpp"
 
 namespace qabot::awaitable {
-template <typename T> class Awaitable {
-  struct SharedState {
-    std::exception_ptr _exceptionPtr = nullptr;
-    std::optional<T> _result;
-    std::coroutine_handle<> handle = nullptr;
-  };
+namespace detail {
+// the readiness an operation that would block waits for
+inline reactor::Interest interestOf(socket::IoErrc wouldBlock) {
+  return wouldBlock == socket::IoErrc::WantWrite ? reactor::Interest::Write
+                                                 : reactor::Interest::Read;
+}
 
+// what an operation that is still blocked at its deadline fails with
+inline std::exception_ptr timedOut() {
+  return std::make_exception_ptr(std::system_error(
+      std::make_error_code(std::errc::timed_out), "Operation timed out"));
+}
+} // namespace detail
+
+// Runs a non-blocking socket operation. The operation returns a
+// socket::IoResult: if it would block the coroutine is suspended and the
+// socket handle is watched by the reactor, the operation is retried on the
+// event loop once the kernel reports the socket ready. Waiting is plain
+// control flow, only the exceptions of a failed operation are rethrown to
+// the coroutine. The operation, its result and the event handed to the
+// reactor all live inside the awaitable, which lives in the suspended
+// coroutine frame, so waiting doesn't allocate.
+//
+// With a deadline, an operation that still can't make progress once the
+// deadline passed fails with std::errc::timed_out.
+template <typename T, typename Func> class Awaitable {
 public:
-  Awaitable(std::function<T()> &&func)
-      : _func(std::move(func)), _sharedState(std::make_shared<SharedState>()) {}
+  Awaitable(reactor::NativeHandle handle, Func func,
+            reactor::Clock::time_point deadline = reactor::kNoDeadline)
+      : _handle(handle), _func(std::move(func)), _deadline(deadline) {}
 
-  bool await_ready() {
-    // Check if the socket is ready for I/O operations
-    try {
-      _sharedState->_result.emplace(std::move(_func()));
-      return true;
-    } catch (const std::system_error &e) {
-      if (e.code() == std::errc::operation_would_block ||
-          e.code() == std::errc::resource_unavailable_try_again ||
-          e.code() == std::errc::connection_already_in_progress
-#ifdef _WIN32
-          || e.code() == static_cast<std::errc>(WSAEWOULDBLOCK) ||
-          e.code() == static_cast<std::errc>(WSAEALREADY)
-#endif
-      ) {
-        // Handle non-blocking operation
-        return false;
-      } else {
-        // Handle other exceptions
-        _sharedState->_exceptionPtr = std::current_exception();
-        return true;
-      }
-    } catch (const std::exception &e) {
-      // Handle other exceptions
-      _sharedState->_exceptionPtr = std::current_exception();
-      return true;
-    }
-    return false;
+  // only before the awaitable is awaited, a later deadline doesn't extend
+  // an earlier one
+  void setDeadline(reactor::Clock::time_point deadline) {
+    _deadline = std::min(_deadline, deadline);
   }
 
-  void await_suspend(std::coroutine_handle<> handle) {
-    // Suspend the coroutine and register the handle
-    // This is where you would typically set up an event loop or I/O
-    // multiplexing z
-    if (!_func) {
-      throw std::runtime_error("Function not set");
-    }
+  bool await_ready() { return _try(); }
 
-    _sharedState->handle = handle;
+  void await_suspend(std::coroutine_handle<> handle) {
+    // Suspend the coroutine and wait for the socket to become ready
+    _coroutineHandle = handle;
 
-    _submitToEventLoop();
+    _waitForReady();
   }
 
   T &await_resume() {
-    if (_sharedState->_exceptionPtr) {
-      std::rethrow_exception(_sharedState->_exceptionPtr);
-    }
-    if (_sharedState->_result.has_value()) {
-      return *_sharedState->_result;
-    } else {
-      throw std::runtime_error("Function did not return a value");
+    if (_exceptionPtr) {
+      std::rethrow_exception(_exceptionPtr);
     }
+    return *_result;
   }
 
 private:
-  std::function<T()> _func;
-  std::shared_ptr<SharedState> _sharedState;
-
-  void _submitToEventLoop() {
-    // Submit the function to the event loop
-    event_manager::EventManager::getInstance().addEvent([this]() mutable {
-      try {
-        _sharedState->_result.emplace(std::move(_func()));
-
-      } catch (const std::system_error &e) {
-        // Handle exception
-        if (e.code() == std::errc::operation_would_block ||
-            e.code() == std::errc::resource_unavailable_try_again ||
-            e.code() == std::errc::connection_already_in_progress
-#ifdef _WIN32
-            || e.code() == static_cast<std::errc>(WSAEWOULDBLOCK) ||
-            e.code() == static_cast<std::errc>(WSAEALREADY)
-#endif
-        ) {
-          std::this_thread::sleep_for(std::chrono::milliseconds(100));
-          _submitToEventLoop();
-
-          return;
-
-        } else {
-          _sharedState->_exceptionPtr = std::current_exception();
-        }
-      } catch (const std::exception &e) {
-        // Handle other exceptions
-        _sharedState->_exceptionPtr = std::current_exception();
-      }
+  reactor::NativeHandle _handle;
+  Func _func;
+  reactor::Clock::time_point _deadline;
+  std::optional<T> _result;
+  std::exception_ptr _exceptionPtr = nullptr;
+  std::coroutine_handle<> _coroutineHandle = nullptr;
+  reactor::Interest _interest = reactor::Interest::Read;
 
-      if (_sharedState->handle) {
-        _sharedState->handle.resume();
+  // runs the operation once, returns false if it would block
+  bool _try() {
+    try {
+      auto result = _func();
+      if (!result) {
+        _interest = detail::interestOf(result.error());
+        return false;
       }
-    });
+      _result.emplace(std::move(*result));
+    } catch (...) {
+      _exceptionPtr = std::current_exception();
+    }
+    return true;
   }
-};
-template <> class Awaitable<void> {
-  struct SharedState {
-    std::exception_ptr _exceptionPtr = nullptr;
-    std::coroutine_handle<> handle = nullptr;
-  };
 
-public:
-  Awaitable(std::function<void()> &&func)
-      : _func(std::move(func)), _sharedState(std::make_shared<SharedState>()) {}
+  void _waitForReady() {
+    // Nothing may touch this awaitable after the watch is registered, the
+    // event can already be running on a worker
+    reactor::Reactor::getInstance().watch(
+        _handle, _interest, event_manager::Event{&Awaitable::_onReady, this},
+        _deadline);
+  }
 
-  bool await_ready() {
-    // Check if the socket is ready for I/O operations
-    try {
-      _func();
-      return true;
-    } catch (const std::system_error &e) {
-      if (e.code() == std::errc::operation_would_block ||
-          e.code() == std::errc::resource_unavailable_try_again ||
-          e.code() == std::errc::connection_already_in_progress
-#ifdef _WIN32
-          || e.code() == static_cast<std::errc>(WSAEWOULDBLOCK) ||
-          e.code() == static_cast<std::errc>(WSAEALREADY)
-#endif
-      ) {
-        // Handle non-blocking operation
-        return false;
-      } else {
-        // Handle other exceptions
-        _sharedState->_exceptionPtr = std::current_exception();
-        return true;
+  static void _onReady(void *self) {
+    static_cast<Awaitable *>(self)->_retry();
+  }
+
+  void _retry() {
+    if (!_try()) {
+      if (reactor::Clock::now() < _deadline) {
+        // still not ready, go back to the reactor
+        _waitForReady();
+        return;
       }
-    } catch (const std::exception &e) {
-      // Handle other exceptions
-      _sharedState->_exceptionPtr = std::current_exception();
-      return true;
+      _exceptionPtr = detail::timedOut();
     }
-    return false;
-  }
 
-  void await_suspend(std::coroutine_handle<> handle) {
-    // Suspend the coroutine and register the handle
-    // This is where you would typically set up an event loop or I/O
-    // multiplexing z
-    if (!_func) {
-      throw std::runtime_error("Function not set");
+    if (_coroutineHandle) {
+      _coroutineHandle.resume();
     }
+  }
+};
+template <typename Func> class Awaitable<void, Func> {
+public:
+  Awaitable(reactor::NativeHandle handle, Func func,
+            reactor::Clock::time_point deadline = reactor::kNoDeadline)
+      : _handle(handle), _func(std::move(func)), _deadline(deadline) {}
+
+  // only before the awaitable is awaited, a later deadline doesn't extend
+  // an earlier one
+  void setDeadline(reactor::Clock::time_point deadline) {
+    _deadline = std::min(_deadline, deadline);
+  }
 
-    _sharedState->handle = handle;
+  bool await_ready() { return _try(); }
 
-    _submitToEventLoop();
+  void await_suspend(std::coroutine_handle<> handle) {
+    // Suspend the coroutine and wait for the socket to become ready
+    _coroutineHandle = handle;
+
+    _waitForReady();
   }
 
   void await_resume() {
-    if (_sharedState->_exceptionPtr) {
-      std::rethrow_exception(_sharedState->_exceptionPtr);
+    if (_exceptionPtr) {
+      std::rethrow_exception(_exceptionPtr);
     }
   }
 
 private:
-  std::function<void()> _func;
-  std::shared_ptr<SharedState> _sharedState;
-
-  void _submitToEventLoop() {
-    // Submit the function to the event loop
-    event_manager::EventManager::getInstance().addEvent([this]() mutable {
-      try {
-        _func();
-      } catch (const std::system_error &e) {
-        // Handle exception
-        if (e.code() == std::errc::operation_would_block ||
-            e.code() == std::errc::resource_unavailable_try_again ||
-            e.code() == std::errc::connection_already_in_progress ||
-            e.code() == std::errc::operation_in_progress
-#ifdef _WIN32
-            || e.code() == static_cast<std::errc>(WSAEWOULDBLOCK) ||
-            e.code() == static_cast<std::errc>(WSAEALREADY)
-#endif
-        ) {
-          std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-          _submitToEventLoop();
-
-          return;
-
-        } else {
-          _sharedState->_exceptionPtr = std::current_exception();
-        }
-      } catch (const std::exception &e) {
-        // Handle other exceptions
-        _sharedState->_exceptionPtr = std::current_exception();
+  reactor::NativeHandle _handle;
+  Func _func;
+  reactor::Clock::time_point _deadline;
+  std::exception_ptr _exceptionPtr = nullptr;
+  std::coroutine_handle<> _coroutineHandle = nullptr;
+  reactor::Interest _interest = reactor::Interest::Read;
+
+  // runs the operation once, returns false if it would block
+  bool _try() {
+    try {
+      if (auto result = _func(); !result) {
+        _interest = detail::interestOf(result.error());
+        return false;
       }
+    } catch (...) {
+      _exceptionPtr = std::current_exception();
+    }
+    return true;
+  }
+
+  void _waitForReady() {
+    // Nothing may touch this awaitable after the watch is registered, the
+    // event can already be running on a worker
+    reactor::Reactor::getInstance().watch(
+        _handle, _interest, event_manager::Event{&Awaitable::_onReady, this},
+        _deadline);
+  }
 
-      if (_sharedState->handle) {
-        _sharedState->handle.resume();
+  static void _onReady(void *self) {
+    static_cast<Awaitable *>(self)->_retry();
+  }
+
+  void _retry() {
+    if (!_try()) {
+      if (reactor::Clock::now() < _deadline) {
+        // still not ready, go back to the reactor
+        _waitForReady();
+        return;
       }
-    });
+      _exceptionPtr = detail::timedOut();
+    }
+
+    if (_coroutineHandle) {
+      _coroutineHandle.resume();
+    }
   }
 };
 
-// let compiler automatically deduce the return type
+// let compiler automatically deduce the return type, the value of the
+// operation's IoResult
 template <typename Func>
-Awaitable(Func &&func) -> Awaitable<std::invoke_result_t<std::decay_t<Func>>>;
-} // namespace qabot::awaitable
\ No newline at end of file
+Awaitable(reactor::NativeHandle handle, Func func)
+    -> Awaitable<typename std::invoke_result_t<Func &>::value_type, Func>;
+
+template <typename Func>
+Awaitable(reactor::NativeHandle handle, Func func,
+          reactor::Clock::time_point deadline)
+    -> Awaitable<typename std::invoke_result_t<Func &>::value_type, Func>;
+
+// The operation has timeout from now on to finish, it fails with
+// std::errc::timed_out otherwise:
+//
+//   auto line = co_await withTimeout(reader.readLine(), 5s);
+template <typename T, typename Func, typename Rep, typename Period>
+Awaitable<T, Func> withTimeout(Awaitable<T, Func> awaitable,
+                               std::chrono::duration<Rep, Period> timeout) {
+  awaitable.setDeadline(reactor::Clock::now() + timeout);
+  return awaitable;
+}
+
+// Suspends the coroutine until the deadline, it is queued back on the worker
+// it was suspended on. The timer lives in the awaitable, sleeping doesn't
+// allocate.
+class Sleep {
+public:
+  explicit Sleep(reactor::Clock::time_point deadline) : _deadline(deadline) {}
+
+  Sleep(const Sleep &) = delete;
+  Sleep &operator=(const Sleep &) = delete;
+
+  ~Sleep() {
+    if (_isScheduled) {
+      // the coroutine may be destroyed while it sleeps
+      reactor::Reactor::getInstance().cancel(_waiter);
+    }
+  }
+
+  bool await_ready() const { return reactor::Clock::now() >= _deadline; }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    _isScheduled = true;
+    reactor::Reactor::getInstance().schedule(
+        _waiter, _deadline, event_manager::Event::fromHandle(handle));
+  }
+
+  void await_resume() const {}
+
+private:
+  reactor::Clock::time_point _deadline;
+  reactor::Waiter _waiter;
+  bool _isScheduled = false;
+};
+
+// Moves the coroutine over to the given worker, it carries on there once the
+// worker gets to it. kAnyWorker or the current worker don't suspend.
+class ResumeOn {
+public:
+  explicit ResumeOn(size_t workerIndex) : _workerIndex(workerIndex) {}
+
+  bool await_ready() const {
+    return _workerIndex == event_manager::EventManager::kAnyWorker ||
+           _workerIndex == event_manager::EventManager::currentWorker();
+  }
+
+  void await_suspend(std::coroutine_handle<> handle) const {
+    event_manager::EventManager::getInstance().addEvent(
+        event_manager::Event::fromHandle(handle), _workerIndex);
+  }
+
+  void await_resume() const {}
+
+private:
+  size_t _workerIndex;
+};
+
+inline ResumeOn resumeOn(size_t workerIndex) { return ResumeOn(workerIndex); }
+
+inline Sleep sleepUntil(reactor::Clock::time_point deadline) {
+  return Sleep(deadline);
+}
+
+template <typename Rep, typename Period>
+Sleep sleepFor(std::chrono::duration<Rep, Period> duration) {
+  return Sleep(reactor::Clock::now() + duration);
+}
+} // namespace qabot::awaitable
@@ -0,0 +1,127 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace qabot::buffer_pool {
+// Receive buffers in a few fixed size classes. Connections borrow one only
+// while they have unread bytes and grow into the next class when a message
+// doesn't fit, so an idle connection holds no buffer at all and a busy one
+// only as much as its largest message needs.
+//
+// Every thread keeps its own free lists, borrowing and returning a buffer
+// never takes a lock. A buffer may be returned on another thread than the
+// one it came from, it simply joins that thread's list.
+class BufferPool {
+public:
+  static constexpr std::array<size_t, 3> kSizeClasses = {
+      4 * 1024, 16 * 1024, 64 * 1024};
+  // free buffers kept per class and thread, the rest goes back to malloc
+  static constexpr size_t kMaxFreePerClass = 64;
+
+  // A borrowed buffer, goes back to the pool it came from when destroyed.
+  // Sizes above the largest class are allocated exactly and never pooled.
+  class Buffer {
+  public:
+    Buffer() = default;
+
+    Buffer(Buffer &&other) noexcept
+        : _data(std::move(other._data)), _size(std::exchange(other._size, 0)) {
+    }
+
+    Buffer &operator=(Buffer &&other) noexcept {
+      if (this != &other) {
+        reset();
+        _data = std::move(other._data);
+        _size = std::exchange(other._size, 0);
+      }
+      return *this;
+    }
+
+    ~Buffer() { reset(); }
+
+    char *data() { return _data.get(); }
+    const char *data() const { return _data.get(); }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    // hand the memory back to the pool
+    void reset() {
+      if (_data && !_isDestroyed) {
+        BufferPool::getInstance()._release(std::move(_data), _size);
+      }
+      _data.reset();
+      _size = 0;
+    }
+
+  private:
+    friend class BufferPool;
+
+    Buffer(std::unique_ptr<char[]> data, size_t size)
+        : _data(std::move(data)), _size(size) {}
+
+    std::unique_ptr<char[]> _data;
+    size_t _size = 0;
+  };
+
+  // one pool per thread
+  static BufferPool &getInstance() {
+    static thread_local BufferPool instance;
+    return instance;
+  }
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+  BufferPool(BufferPool &&) = delete;
+  BufferPool &operator=(BufferPool &&) = delete;
+
+  // a buffer of at least size bytes, not zeroed
+  Buffer acquire(size_t size) {
+    auto sizeClass = _classFor(size);
+    if (sizeClass == kSizeClasses.size()) {
+      return Buffer(std::make_unique_for_overwrite<char[]>(size), size);
+    }
+
+    auto classSize = kSizeClasses[sizeClass];
+    auto &freeList = _freeLists[sizeClass];
+    if (freeList.empty()) {
+      return Buffer(std::make_unique_for_overwrite<char[]>(classSize),
+                    classSize);
+    }
+    auto data = std::move(freeList.back());
+    freeList.pop_back();
+    return Buffer(std::move(data), classSize);
+  }
+
+private:
+  BufferPool() = default;
+  // buffers that outlive the thread's pool (e.g. in static singletons) are
+  // freed directly
+  ~BufferPool() { _isDestroyed = true; }
+
+  // index into kSizeClasses, kSizeClasses.size() if none is big enough
+  static size_t _classFor(size_t size) {
+    size_t sizeClass = 0;
+    while (sizeClass < kSizeClasses.size() && kSizeClasses[sizeClass] < size) {
+      ++sizeClass;
+    }
+    return sizeClass;
+  }
+
+  void _release(std::unique_ptr<char[]> data, size_t size) {
+    auto sizeClass = _classFor(size);
+    if (sizeClass == kSizeClasses.size() || kSizeClasses[sizeClass] != size ||
+        _freeLists[sizeClass].size() >= kMaxFreePerClass) {
+      return;
+    }
+    _freeLists[sizeClass].push_back(std::move(data));
+  }
+
+  std::array<std::vector<std::unique_ptr<char[]>>, kSizeClasses.size()>
+      _freeLists;
+
+  static inline thread_local bool _isDestroyed = false;
+};
+} // namespace qabot::buffer_pool
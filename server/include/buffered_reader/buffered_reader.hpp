@@ -0,0 +1,202 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "awaitable/awaitable.hpp"
+#include "buffer_pool/buffer_pool.hpp"
+#include "http/http_scan.hpp"
+#include "socket/io_error.hpp"
+
+namespace qabot::buffered_reader {
+// Reads a stream through a reusable buffer so that line based protocols
+// don't cost one receive per byte. Every receive asks for as much as the
+// buffer can hold (a whole TLS record for SecureSocket) and the read
+// operations hand out views into the buffer.
+//
+// The buffer is borrowed from the BufferPool only while there are unread
+// bytes, a reader waiting for data holds none. It starts at the given
+// capacity and moves up the size classes when a message doesn't fit, but
+// never holds more than maxSize unread bytes.
+//
+// A returned view stays valid until the next read operation on the reader.
+// Stream needs receiveSome(char *, size_t) returning a socket::IoResult that
+// holds 0 at end of stream, and getSocketFD().
+template <typename Stream> class BufferedReader {
+public:
+  static constexpr size_t kDefaultCapacity =
+      buffer_pool::BufferPool::kSizeClasses.front();
+  static constexpr size_t kUnlimited = std::numeric_limits<size_t>::max();
+
+  explicit BufferedReader(Stream &stream, size_t capacity = kDefaultCapacity,
+                          size_t maxSize = kUnlimited)
+      : _stream(stream), _capacity(capacity), _maxSize(maxSize) {}
+
+  BufferedReader(const BufferedReader &) = delete;
+  BufferedReader &operator=(const BufferedReader &) = delete;
+
+  // next line without its line terminator ("\n" or "\r\n")
+  auto readLine() {
+    return awaitable::Awaitable(_stream.getSocketFD(),
+                                [this]() { return _tryReadLine(); });
+  }
+
+  // exactly size bytes, the buffer grows if size doesn't fit
+  auto readExact(size_t size) {
+    return awaitable::Awaitable(_stream.getSocketFD(), [this, size]() {
+      return _tryReadExact(size);
+    });
+  }
+
+  // whatever is buffered, waiting for at least one byte, empty at end of
+  // stream
+  auto readSome() {
+    return awaitable::Awaitable(_stream.getSocketFD(),
+                                [this]() { return _tryReadSome(); });
+  }
+
+  // receive more without consuming anything, for parsers that work on
+  // buffered() directly. Returns the number of bytes received, 0 at end of
+  // stream. Fails with std::errc::timed_out if nothing arrived by the
+  // deadline.
+  auto fill(reactor::Clock::time_point deadline = reactor::kNoDeadline) {
+    return awaitable::Awaitable(
+        _stream.getSocketFD(), [this]() { return _fill(); }, deadline);
+  }
+
+  std::string_view buffered() const {
+    return {_buffer.data() + _readPos, _writePos - _readPos};
+  }
+
+  void consume(size_t size) {
+    _readPos += std::min(size, _writePos - _readPos);
+    _scanned = 0;
+    if (_readPos == _writePos) {
+      _readPos = _writePos = 0;
+    }
+  }
+
+private:
+  socket::IoResult<std::string_view> _tryReadLine() {
+    while (true) {
+      auto data = buffered();
+      // don't scan the bytes we already looked at before the last receive
+      if (auto pos = http::findNewline(data, _scanned); pos != data.npos) {
+        _scanned = 0;
+        auto line = data.substr(0, pos);
+        consume(pos + 1);
+        if (!line.empty() && line.back() == '\r') {
+          line.remove_suffix(1);
+        }
+        return line;
+      }
+      _scanned = data.size();
+      if (auto filled = _fillOrThrow(); !filled) {
+        return std::unexpected(filled.error());
+      }
+    }
+  }
+
+  socket::IoResult<std::string_view> _tryReadExact(size_t size) {
+    while (_writePos - _readPos < size) {
+      if (auto filled = _fillOrThrow(size); !filled) {
+        return std::unexpected(filled.error());
+      }
+    }
+    auto data = buffered().substr(0, size);
+    consume(size);
+    return data;
+  }
+
+  socket::IoResult<std::string_view> _tryReadSome() {
+    if (_readPos == _writePos) {
+      auto bytesReceived = _fill();
+      if (!bytesReceived) {
+        return std::unexpected(bytesReceived.error());
+      }
+      if (*bytesReceived == 0) {
+        return std::string_view();
+      }
+    }
+    auto data = buffered();
+    consume(data.size());
+    return data;
+  }
+
+  // a receive that has to bring more, the end of the stream is an error
+  socket::IoResult<void> _fillOrThrow(size_t required = 0) {
+    auto bytesReceived = _fill(required);
+    if (!bytesReceived) {
+      return std::unexpected(bytesReceived.error());
+    }
+    if (*bytesReceived == 0) {
+      throw std::runtime_error("Connection closed by peer");
+    }
+    return {};
+  }
+
+  // one receive into the free tail of the buffer, returns 0 at end of stream
+  // and the stream's would-block status if nothing is there
+  socket::IoResult<size_t> _fill(size_t required = 0) {
+    if (_buffer.empty()) {
+      _buffer = buffer_pool::BufferPool::getInstance().acquire(
+          std::max(_capacity, required));
+    } else if (_readPos > 0) {
+      // move the unread bytes to the front, views handed out before are
+      // dead by now
+      std::memmove(_buffer.data(), _buffer.data() + _readPos,
+                   _writePos - _readPos);
+      _writePos -= _readPos;
+      _readPos = 0;
+    }
+    if (_writePos == _maxSize || required > _maxSize) {
+      throw std::runtime_error("Message exceeds the maximum size of " +
+                               std::to_string(_maxSize) + " bytes");
+    }
+    if (_writePos == _buffer.size() || required > _buffer.size()) {
+      _grow(std::max(_buffer.size() * 2, required));
+    }
+
+    socket::IoResult<size_t> bytesReceived;
+    try {
+      bytesReceived = _stream.receiveSome(
+          _buffer.data() + _writePos,
+          std::min(_buffer.size(), _maxSize) - _writePos);
+    } catch (...) {
+      _releaseIfEmpty();
+      throw;
+    }
+    if (bytesReceived) {
+      _writePos += *bytesReceived;
+    }
+    _releaseIfEmpty();
+    return bytesReceived;
+  }
+
+  // move the unread bytes into a buffer of the next fitting size class
+  void _grow(size_t size) {
+    auto grown = buffer_pool::BufferPool::getInstance().acquire(size);
+    std::memcpy(grown.data(), _buffer.data(), _writePos);
+    _buffer = std::move(grown);
+  }
+
+  // nothing to keep, give the buffer back while we wait for the stream
+  void _releaseIfEmpty() {
+    if (_writePos == 0) {
+      _buffer.reset();
+    }
+  }
+
+  Stream &_stream;
+  size_t _capacity;
+  size_t _maxSize;
+  buffer_pool::BufferPool::Buffer _buffer;
+  size_t _readPos = 0;
+  size_t _writePos = 0;
+  // how far _tryReadLine already searched for the line terminator
+  size_t _scanned = 0;
+};
+} // namespace qabot::buffered_reader
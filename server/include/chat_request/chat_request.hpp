@@ -0,0 +1,31 @@
+#pragma once
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace qabot::chat_request {
+// The fields of a chat request, views of the still escaped strings in the
+// request body
+struct ChatRequest {
+  explicit ChatRequest(std::pmr::polymorphic_allocator<> allocator)
+      : context(allocator) {}
+
+  std::string_view modelName;
+  std::string_view prompt;
+  std::string_view message;
+  // role and text of every earlier turn, in order
+  std::pmr::vector<std::pair<std::string_view, std::string_view>> context;
+};
+
+// Pulls the fields out of the body in one pass without building a DOM,
+// anything else in the body is skipped. Throws std::runtime_error if the
+// body is malformed or a required field is missing.
+ChatRequest parseChatRequest(std::string_view body,
+                             std::pmr::polymorphic_allocator<> allocator);
+
+// Appends the upstream request body for chat to output. The strings are
+// still escaped and are copied as they are.
+void writeUpstreamBody(std::pmr::string &output, const ChatRequest &chat);
+} // namespace qabot::chat_request
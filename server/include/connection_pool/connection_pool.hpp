@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "buffered_reader/buffered_reader.hpp"
+#include "socket/secure_socket.hpp"
+#include "socket/socket.hpp"
+#include "write_queue/write_queue.hpp"
+
+namespace qabot::connection_pool {
+// Keep-alive upstream connections shared by every client session, keyed by
+// host and port. A session borrows a connection for one request and hands it
+// back once the response has been read completely, so only the first request
+// to a host pays for the TCP and TLS handshakes.
+//
+// Idle connections are dropped after kIdleTimeout, checked for every host on
+// each release. At most kMaxIdlePerHost are kept per host, and a connection
+// is checked before it is handed out again because the server may have
+// closed it in the meantime.
+template <socket::SocketImplConcept SocketImpl> class ConnectionPool {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr auto kIdleTimeout = std::chrono::seconds(60);
+  static constexpr size_t kMaxIdlePerHost = 16;
+
+  // one upstream connection together with the buffers its responses are read
+  // through and its requests are written from, leftover bytes in either
+  // belong to this connection
+  struct Connection {
+    Connection(std::string host, int port)
+        : host(std::move(host)), port(port),
+          socket(socket::TransportProtocol::TCP, socket::IPVersion::IPv4),
+          // room for a whole TLS record per receive
+          reader(socket, 16 * 1024), writer(socket) {}
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    std::string host;
+    int port;
+    socket::SecureSocket<SocketImpl> socket;
+    buffered_reader::BufferedReader<socket::SecureSocket<SocketImpl>> reader;
+    write_queue::WriteQueue<socket::SecureSocket<SocketImpl>> writer;
+
+    // false until the caller finished the handshake
+    bool isConnected = false;
+
+    Clock::time_point lastUsed = Clock::now();
+  };
+
+  // singleton
+  static ConnectionPool &getInstance() {
+    static ConnectionPool instance;
+    return instance;
+  }
+
+  ConnectionPool(const ConnectionPool &) = delete;
+  ConnectionPool &operator=(const ConnectionPool &) = delete;
+  ConnectionPool(ConnectionPool &&) = delete;
+  ConnectionPool &operator=(ConnectionPool &&) = delete;
+
+  // An idle connection to host:port, or a new one with isConnected unset
+  // that the caller still has to connect
+  std::unique_ptr<Connection> acquire(const std::string &host, int port) {
+    while (true) {
+      std::unique_ptr<Connection> connection;
+      {
+        std::lock_guard<std::mutex> lock(_poolMutex);
+        auto it = _idleConnections.find(_key(host, port));
+        if (it == _idleConnections.end() || it->second.empty()) {
+          break;
+        }
+        // the most recently used one is the least likely to be closed
+        connection = std::move(it->second.back());
+        it->second.pop_back();
+      }
+
+      if (Clock::now() - connection->lastUsed < kIdleTimeout &&
+          connection->socket.isIdleAlive()) {
+        return connection;
+      }
+      // expired or closed by the server, try the next one
+    }
+    return std::make_unique<Connection>(host, port);
+  }
+
+  // Give a connection back after its response was read completely. Drop the
+  // connection instead when a request failed half way, its state is unknown.
+  void release(std::unique_ptr<Connection> connection) {
+    if (!connection->isConnected || !connection->reader.buffered().empty() ||
+        connection->writer.pending() > 0) {
+      // unread or unsent bytes mean we lost track of the framing
+      return;
+    }
+    connection->lastUsed = Clock::now();
+
+    // closed after the lock is released
+    std::vector<std::unique_ptr<Connection>> evicted;
+    std::lock_guard<std::mutex> lock(_poolMutex);
+    _sweep(connection->lastUsed, evicted);
+    auto &idle = _idleConnections[_key(connection->host, connection->port)];
+    if (idle.size() >= kMaxIdlePerHost) {
+      // drop the one that waited longest
+      evicted.push_back(std::move(idle.front()));
+      idle.erase(idle.begin());
+    }
+    idle.push_back(std::move(connection));
+  }
+
+private:
+  ConnectionPool() = default;
+
+  // Move the expired connections of every host into evicted, so hosts that
+  // are not asked for again don't keep their sockets open. Each list is
+  // ordered oldest first. Needs _poolMutex.
+  void _sweep(Clock::time_point now,
+              std::vector<std::unique_ptr<Connection>> &evicted) {
+    for (auto it = _idleConnections.begin(); it != _idleConnections.end();) {
+      auto &idle = it->second;
+      auto fresh = std::find_if(idle.begin(), idle.end(), [&](auto &entry) {
+        return now - entry->lastUsed < kIdleTimeout;
+      });
+      std::move(idle.begin(), fresh, std::back_inserter(evicted));
+      idle.erase(idle.begin(), fresh);
+      it = idle.empty() ? _idleConnections.erase(it) : std::next(it);
+    }
+  }
+
+  static std::string _key(const std::string &host, int port) {
+    return host + ":" + std::to_string(port);
+  }
+
+  std::unordered_map<std::string, std::vector<std::unique_ptr<Connection>>>
+      _idleConnections;
+
+  std::mutex _poolMutex;
+};
+} // namespace qabot::connection_pool
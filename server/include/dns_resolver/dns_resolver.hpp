@@ -0,0 +1,154 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "event_manager/event_manager.hpp"
+#include "socket/endpoint.hpp"
+#include "socket/socket.hpp"
+
+namespace qabot::dns_resolver {
+// Resolves host names on its own thread so getaddrinfo never blocks an event
+// loop worker. Results are cached for kCacheTtl and every lookup of a cached
+// name starts at the next address, spreading connections over all records
+// of the requested family.
+//
+// getaddrinfo doesn't report the record TTLs, so the cache uses a fixed
+// lifetime that is shorter than what the name servers publish for the hosts
+// we talk to.
+class DnsResolver {
+  // one pending lookup, lives in the awaiting coroutine's frame
+  struct Lookup {
+    std::string host;
+    int port = 0;
+    socket::IPVersion ipVersion = socket::IPVersion::IPv4;
+
+    std::vector<socket::Endpoint> endpoints;
+    std::exception_ptr exceptionPtr = nullptr;
+
+    event_manager::Event onDone;
+    size_t workerIndex = event_manager::EventManager::kAnyWorker;
+  };
+
+public:
+  static constexpr auto kCacheTtl = std::chrono::seconds(30);
+
+  // blocking lookup of every address of host, throws if there is none
+  using LookupFunction = std::function<std::vector<socket::Endpoint>(
+      const std::string &host, int port, socket::IPVersion ipVersion)>;
+
+  // Suspends the coroutine until the lookup finished on the resolver thread,
+  // a cached name resolves without suspending. Yields the endpoints, throws
+  // if the name can't be resolved.
+  class ResolveAwaitable {
+  public:
+    ResolveAwaitable(DnsResolver &resolver, std::string host, int port,
+                     socket::IPVersion ipVersion)
+        : _resolver(resolver) {
+      _lookup.host = std::move(host);
+      _lookup.port = port;
+      _lookup.ipVersion = ipVersion;
+    }
+
+    bool await_ready() {
+      if (auto cached = _resolver._fromCache(_lookup); cached) {
+        _lookup.endpoints = std::move(*cached);
+        return true;
+      }
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      _lookup.onDone = event_manager::Event::fromHandle(handle);
+      _lookup.workerIndex = event_manager::EventManager::currentWorker();
+      // the resolver thread may resume the coroutine right away, nothing
+      // may touch this awaitable afterwards
+      _resolver._enqueue(&_lookup);
+    }
+
+    std::vector<socket::Endpoint> await_resume() {
+      if (_lookup.exceptionPtr) {
+        std::rethrow_exception(_lookup.exceptionPtr);
+      }
+      return std::move(_lookup.endpoints);
+    }
+
+  private:
+    DnsResolver &_resolver;
+    Lookup _lookup;
+  };
+
+  // singleton
+  static DnsResolver &getInstance() {
+    static DnsResolver instance;
+    return instance;
+  }
+
+  // Replaces getaddrinfo on the resolver thread, lets tests answer from a
+  // stub. Only set it before the first resolve.
+  static void setLookupFunction(LookupFunction lookupFunction) {
+    _lookupFunction = std::move(lookupFunction);
+  }
+
+  DnsResolver(const DnsResolver &) = delete;
+  DnsResolver &operator=(const DnsResolver &) = delete;
+  DnsResolver(DnsResolver &&) = delete;
+  DnsResolver &operator=(DnsResolver &&) = delete;
+
+  ResolveAwaitable resolve(std::string host, int port,
+                           socket::IPVersion ipVersion) {
+    return ResolveAwaitable(*this, std::move(host), port, ipVersion);
+  }
+
+private:
+  struct CacheEntry {
+    std::vector<socket::Endpoint> endpoints;
+    std::chrono::steady_clock::time_point expiresAt;
+    // where the next lookup starts
+    size_t nextIndex = 0;
+  };
+
+  DnsResolver();
+  ~DnsResolver();
+
+  void _resolverLoop();
+
+  void _enqueue(Lookup *lookup);
+
+  // the cached endpoints rotated by one, nothing if the name isn't cached or
+  // expired
+  std::optional<std::vector<socket::Endpoint>>
+  _fromCache(const Lookup &lookup);
+
+  // blocking lookup, only called on the resolver thread
+  std::vector<socket::Endpoint> _lookupNow(const Lookup &lookup);
+
+  static std::vector<socket::Endpoint>
+  _getAddrInfo(const std::string &host, int port,
+               socket::IPVersion ipVersion);
+
+  static std::string _key(const Lookup &lookup);
+
+  std::deque<Lookup *> _pendingLookups;
+  std::mutex _pendingMutex;
+  std::condition_variable _pendingCondition;
+
+  std::unordered_map<std::string, CacheEntry> _cache;
+  std::mutex _cacheMutex;
+
+  std::thread _resolverThread;
+
+  bool _isRunning = true;
+
+  static inline LookupFunction _lookupFunction = &DnsResolver::_getAddrInfo;
+};
+} // namespace qabot::dns_resolver
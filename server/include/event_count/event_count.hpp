@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace qabot::event_count {
+// Lets threads sleep until "something changed" without a mutex. A waiter
+// announces itself with prepareWait(), re-checks its condition and then
+// either cancels or waits for the epoch it saw to move on. Notifiers only
+// touch the epoch when somebody is actually waiting. Waiting is built on
+// std::atomic::wait, which is a futex on Linux.
+class EventCount {
+public:
+  using Key = uint32_t;
+
+  Key prepareWait() {
+    _waiters.fetch_add(1, std::memory_order_seq_cst);
+    return _epoch.load(std::memory_order_seq_cst);
+  }
+
+  void cancelWait() { _waiters.fetch_sub(1, std::memory_order_seq_cst); }
+
+  void wait(Key key) {
+    _epoch.wait(key, std::memory_order_seq_cst);
+    _waiters.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  // wakes a single waiter, callers must publish their state change first
+  void notifyOne() {
+    if (hasWaiters()) {
+      _epoch.fetch_add(1, std::memory_order_seq_cst);
+      _epoch.notify_one();
+    }
+  }
+
+  void notifyAll() {
+    if (hasWaiters()) {
+      _epoch.fetch_add(1, std::memory_order_seq_cst);
+      _epoch.notify_all();
+    }
+  }
+
+  bool hasWaiters() const {
+    // pairs with the fetch_add in prepareWait, either the waiter sees the
+    // notifier's state change or the notifier sees the waiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return _waiters.load(std::memory_order_seq_cst) > 0;
+  }
+
+private:
+  std::atomic<Key> _epoch{0};
+  std::atomic<Key> _waiters{0};
+};
+} // namespace qabot::event_count
@@ -1,82 +1,236 @@
 #pragma once
+#include "event_count/event_count.hpp"
+#include "mpmc_queue/mpmc_queue.hpp"
 #include "thread_safe_queue/thread_safe_queue.hpp"
+#include <algorithm>
 #include <atomic>
-#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
 #include <exception>
-#include <functional>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace qabot::event_manager {
+// A unit of work for the event loop. An event doesn't own anything, the
+// context usually points into a suspended coroutine frame or awaiter, so
+// queuing one never allocates.
+struct Event {
+  void (*callback)(void *context) = nullptr;
+  void *context = nullptr;
+
+  void operator()() const { callback(context); }
+
+  static Event fromHandle(std::coroutine_handle<> handle) {
+    return Event{[](void *address) {
+                   std::coroutine_handle<>::from_address(address).resume();
+                 },
+                 handle.address()};
+  }
+};
+
+// Runs events on a pool of worker threads. Every worker owns a lock-free run
+// queue, events added from a worker stay on that worker, and idle workers
+// steal from their siblings so a busy worker doesn't hold up its backlog.
+// Idle workers sleep on their own EventCount and are woken one at a time.
 class EventManager {
   // singleton
 public:
+  // let the event manager pick the target worker
+  static constexpr size_t kAnyWorker = std::numeric_limits<size_t>::max();
+
   static EventManager &getInstance() {
     static EventManager instance;
     return instance;
   }
 
+  // Number of workers started by the first getInstance() call, 0 means one
+  // per hardware thread. Has no effect once the event manager is running.
+  static void setWorkerCount(size_t workerCount) {
+    _configuredWorkerCount = workerCount;
+  }
+
+  // Pinned workers run on a CPU each and don't steal from each other, an
+  // event stays on the worker it was queued for. Has no effect once the
+  // event manager is running.
+  static void setPinned(bool isPinned) { _isPinned = isPinned; }
+
   EventManager(const EventManager &) = delete;
   EventManager &operator=(const EventManager &) = delete;
   EventManager(EventManager &&) = delete;
   EventManager &operator=(EventManager &&) = delete;
 
-  void addEvent(std::function<void()> event) {
-    _eventQueue.push(event);
-    _taskCondtion.notify_all();
+  // Events added from a worker thread are queued on that same worker so a
+  // resumed coroutine keeps running where it was suspended
+  void addEvent(Event event) { addEvent(event, _currentWorkerIndex); }
+
+  void addEvent(Event event, size_t workerIndex) {
+    if (workerIndex >= _workers.size()) {
+      workerIndex = _nextWorker.fetch_add(1, std::memory_order_relaxed) %
+                    _workers.size();
+    }
+    if (!_workers[workerIndex]->eventQueue.tryPush(event)) {
+      // the run queue is full, park the event where any worker will find it
+      _overflowQueue.push(event);
+      _overflowSize.fetch_add(1, std::memory_order_release);
+    }
+    _wakeFor(workerIndex);
   }
 
+  size_t workerCount() const { return _workers.size(); }
+
+  // index of the worker running the calling thread, kAnyWorker if the caller
+  // is not one of our workers
+  static size_t currentWorker() { return _currentWorkerIndex; }
+
 private:
+  struct Worker {
+    mpmc_queue::MpmcQueue<Event> eventQueue{kRunQueueCapacity};
+
+    event_count::EventCount parking;
+
+    std::thread thread;
+  };
+
+  static constexpr size_t kRunQueueCapacity = 4096;
+
   EventManager() {
-    const int numThreads = std::thread::hardware_concurrency();
+    size_t numThreads = _configuredWorkerCount;
+    if (numThreads == 0) {
+      numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
 
-    for (int i = 0; i < 1; ++i) {
-      _workers.emplace_back([this] { _workerLoop(); });
+    for (size_t i = 0; i < numThreads; ++i) {
+      _workers.emplace_back(std::make_unique<Worker>());
+    }
+    // only start the threads once every queue exists, they steal from each
+    // other right away
+    for (size_t i = 0; i < numThreads; ++i) {
+      _workers[i]->thread = std::thread([this, i] { _workerLoop(i); });
+      if (_isPinned) {
+        _pin(_workers[i]->thread, i);
+      }
     }
   }
   ~EventManager() {
     _isRunning = false;
-    _taskCondtion.notify_all();
     for (auto &worker : _workers) {
-      if (worker.joinable()) {
-        worker.join();
+      worker->parking.notifyAll();
+    }
+    for (auto &worker : _workers) {
+      if (worker->thread.joinable()) {
+        worker->thread.join();
       }
     }
     _workers.clear();
   }
 
-  void _workerLoop() {
-    while (_isRunning) {
+  void _workerLoop(size_t index) {
+    _currentWorkerIndex = index;
+    auto &self = *_workers[index];
 
-      {
-        std::unique_lock<std::mutex> lock(_taskMutex);
-        if (_eventQueue.empty()) {
-          _taskCondtion.wait(
-              lock, [this] { return !_isRunning || !_eventQueue.empty(); });
+    while (_isRunning) {
+      auto event = self.eventQueue.tryPop();
+      if (!event.has_value() &&
+          _overflowSize.load(std::memory_order_acquire) > 0) {
+        event = _overflowQueue.tryPop();
+        if (event.has_value()) {
+          _overflowSize.fetch_sub(1, std::memory_order_release);
         }
       }
-
-      if (!_isRunning) {
-        break;
+      if (!event.has_value() && !_isPinned) {
+        event = _steal(index);
       }
 
-      auto event = std::move(_eventQueue.tryPop());
-
       if (event.has_value()) {
         // call the events
         event.value()();
+        continue;
+      }
+
+      // announce that we are about to sleep, then look again so an event
+      // pushed in between isn't missed
+      auto key = self.parking.prepareWait();
+      if (!_isRunning || !self.eventQueue.empty() ||
+          _overflowSize.load(std::memory_order_acquire) > 0) {
+        self.parking.cancelWait();
+        continue;
       }
+      self.parking.wait(key);
     }
   }
 
-  thread_safe_queue::ThreadSafeQueue<std::function<void()>> _eventQueue;
+  // worker i runs on the i-th of the CPUs the process may use
+  static void _pin([[maybe_unused]] std::thread &thread,
+                   [[maybe_unused]] size_t index) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      return;
+    }
+    auto skip = index % static_cast<size_t>(CPU_COUNT(&allowed));
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (!CPU_ISSET(cpu, &allowed) || skip-- > 0) {
+        continue;
+      }
+      cpu_set_t target;
+      CPU_ZERO(&target);
+      CPU_SET(cpu, &target);
+      pthread_setaffinity_np(thread.native_handle(), sizeof(target), &target);
+      return;
+    }
+#endif
+  }
 
-  std::vector<std::thread> _workers;
+  std::optional<Event> _steal(size_t thiefIndex) {
+    for (size_t offset = 1; offset < _workers.size(); ++offset) {
+      auto &victim = *_workers[(thiefIndex + offset) % _workers.size()];
+      if (auto event = victim.eventQueue.tryPop(); event.has_value()) {
+        return event;
+      }
+    }
+    return std::nullopt;
+  }
 
-  std::condition_variable _taskCondtion;
+  void _wakeFor(size_t workerIndex) {
+    auto &target = *_workers[workerIndex];
+    if (target.parking.hasWaiters()) {
+      target.parking.notifyOne();
+      return;
+    }
+    if (_isPinned) {
+      return;
+    }
+    // the target is busy, let an idle sibling steal the event instead of
+    // waiting behind whatever the target is running
+    for (auto &worker : _workers) {
+      if (worker->parking.hasWaiters()) {
+        worker->parking.notifyOne();
+        return;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+
+  // only used when a worker's run queue is full
+  thread_safe_queue::ThreadSafeQueue<Event> _overflowQueue;
+  std::atomic_size_t _overflowSize{0};
 
-  mutable std::mutex _taskMutex;
+  std::atomic_size_t _nextWorker{0};
 
   std::atomic_bool _isRunning{true};
+
+  static inline size_t _configuredWorkerCount = 0;
+  static inline bool _isPinned = false;
+
+  static inline thread_local size_t _currentWorkerIndex = kAnyWorker;
 };
-} // namespace qabot::event_manager
\ No newline at end of file
+} // namespace qabot::event_manager
@@ -0,0 +1,28 @@
+#pragma once
+#include <optional>
+#include <string_view>
+
+namespace qabot::http {
+// header names and the tokens in their values are case-insensitive
+bool equalsIgnoreCase(std::string_view a, std::string_view b);
+
+// value without the spaces and tabs around it
+std::string_view trim(std::string_view value);
+
+// whether the comma separated list value holds token, like "close" in
+// "Connection: keep-alive, close"
+bool hasToken(std::string_view value, std::string_view token);
+
+// What the header fields of a response say about its body and its
+// connection. Every field of the response head goes through addHeader.
+struct ResponseFraming {
+  bool isChunked = false;
+  std::optional<size_t> contentLength;
+  // the server closes the connection after this response
+  bool isClose = false;
+
+  // returns false for a Content-Length that isn't a number, or that
+  // contradicts an earlier one. The body can't be framed then.
+  bool addHeader(std::string_view name, std::string_view value);
+};
+} // namespace qabot::http
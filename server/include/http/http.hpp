@@ -1,5 +1,9 @@
 #pragma once
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 #include "socket/socket.hpp"
 
@@ -68,6 +72,27 @@ inline std::string requestMethodToString(RequestMethod method) {
   }
 }
 
+// nothing if the method isn't one we support
+inline std::optional<RequestMethod>
+stringToRequestMethod(std::string_view method) {
+  if (method == "POST") {
+    return RequestMethod::Post;
+  } else if (method == "GET") {
+    return RequestMethod::Get;
+  } else if (method == "PUT") {
+    return RequestMethod::Put;
+  } else if (method == "DELETE") {
+    return RequestMethod::Delete;
+  } else if (method == "PATCH") {
+    return RequestMethod::Patch;
+  } else if (method == "OPTIONS") {
+    return RequestMethod::Options;
+  } else if (method == "HEAD") {
+    return RequestMethod::Head;
+  }
+  return std::nullopt;
+}
+
 inline std::string responseStatusToString(ResponseStatus status) {
   switch (status) {
   case ResponseStatus::OK:
@@ -7,6 +7,5 @@
 #include "http.hpp"
 
 namespace qabot::http {
-HttpRequest parseRequest(const std::string& rawHttp);
 HttpResponse parseResponse(const std::string& rawHttp);
 }  // namespace qabot::http
\ No newline at end of file
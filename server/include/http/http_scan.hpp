@@ -0,0 +1,19 @@
+#pragma once
+#include <string_view>
+
+namespace qabot::http {
+// Delimiter search for the HTTP parsers and BufferedReader::readLine. The
+// two-byte search compares 16 (SSE2) or 32 (AVX2) bytes at a time, the widest
+// one the CPU supports is picked once at startup and a plain loop is used
+// everywhere else. A single byte goes to memchr. Every function returns
+// std::string_view::npos when there is no match.
+
+// offset of the first '\n' at or after from
+size_t findNewline(std::string_view data, size_t from = 0);
+
+// offset of the first ':' or '\n' at or after from, splits a header line
+size_t findColonOrNewline(std::string_view data, size_t from = 0);
+
+// name of the two-byte scanner in use, "avx2", "sse2" or "scalar"
+std::string_view scanImplementation();
+} // namespace qabot::http
@@ -0,0 +1,50 @@
+#pragma once
+#include <initializer_list>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace qabot::http {
+// An HTTP message whose start line and headers are assembled once, up front.
+// Rendering only appends the few variable parts, the Content-Length and the
+// body behind the prepared fragments, with a single reservation and no
+// formatting.
+//
+//   MessageTemplate hello({"GET /hello/", " HTTP/1.1\r\nHost: a\r\n"});
+//   hello.render(output, {name}, "");
+//
+// The head is given as fragments with a hole between every two of them, it
+// must not contain Content-Length or the blank line, both are added.
+class MessageTemplate {
+public:
+  explicit MessageTemplate(std::initializer_list<std::string_view> fragments);
+
+  // append the message to output, values fill the holes in order
+  void render(std::pmr::string &output,
+              std::initializer_list<std::string_view> values,
+              std::string_view body) const;
+
+  // number of values render expects
+  size_t holes() const { return _fragments.size() - 1; }
+
+private:
+  std::vector<std::string> _fragments;
+  size_t _fixedSize = 0;
+};
+
+// Head of the SSE stream relayed to the client, the events follow as chunks
+inline constexpr std::string_view kEventStreamResponseHead =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+// the same for the last response on a connection
+inline constexpr std::string_view kEventStreamResponseHeadClose =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+} // namespace qabot::http
@@ -0,0 +1,131 @@
+#pragma once
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "http.hpp"
+
+namespace qabot::http {
+enum class ParseStatus {
+  Incomplete,
+  Complete,
+};
+
+// Request line and headers of a parsed request. The views point into the
+// bytes the request was parsed from.
+struct RequestHead {
+  RequestMethod method = RequestMethod::Get;
+  std::string_view path;
+  std::string_view version;
+  std::vector<std::pair<std::string_view, std::string_view>> headers;
+
+  // header names are case-insensitive
+  std::optional<std::string_view> header(std::string_view name) const;
+
+  // whether the client wants the connection kept open after the response,
+  // the default for HTTP/1.1 unless it sent "Connection: close"
+  bool keepAlive() const;
+};
+
+// Resumable HTTP/1.1 request parser. Feed it the unconsumed bytes of a
+// connection every time more of them arrive: the parser remembers how far it
+// got, so no byte is looked at twice, and it never copies anything. The body
+// is framed by Content-Length or chunked transfer encoding, which is what
+// makes several requests pipelined on one keep-alive connection work: once a
+// request is complete, messageSize() tells how many bytes it took and
+// whatever follows is the next request.
+//
+// While parsing only offsets are kept, so the caller may move its buffer
+// around between calls (e.g. compact it) as long as the bytes stay the same.
+// head() and bodyParts() point into the data passed to the call that
+// completed the request.
+class RequestParser {
+public:
+  static constexpr size_t kMaxHeadSize = 64 * 1024;
+  static constexpr size_t kUnlimited = std::numeric_limits<size_t>::max();
+
+  // a body above maxBodySize is rejected as soon as its Content-Length or
+  // chunk size line says so
+  explicit RequestParser(size_t maxBodySize = kUnlimited)
+      : _maxBodySize(maxBodySize) {}
+
+  // data has to start at the first byte of the request and hold at least
+  // everything passed to the previous calls
+  ParseStatus parse(std::string_view data);
+
+  // start over for the next request on the connection
+  void reset();
+
+  bool isComplete() const { return _state == State::Complete; }
+
+  // bytes the request takes, head and body, only valid once complete
+  size_t messageSize() const { return _offset; }
+
+  const RequestHead &head() const { return _head; }
+
+  // the body, one part for Content-Length and one per chunk for chunked
+  // encoding
+  const std::vector<std::string_view> &bodyParts() const {
+    return _bodyParts;
+  }
+
+  size_t bodySize() const;
+
+private:
+  enum class State {
+    RequestLine,
+    Headers,
+    Body,
+    ChunkSize,
+    ChunkData,
+    Trailers,
+    Complete,
+  };
+
+  struct Span {
+    size_t offset;
+    size_t size;
+
+    std::string_view in(std::string_view data) const {
+      return data.substr(offset, size);
+    }
+  };
+
+  // next line starting at _offset without its terminator, nothing if it
+  // hasn't fully arrived yet
+  std::optional<Span> _nextLine(std::string_view data);
+
+  void _parseRequestLine(std::string_view data, Span line);
+  void _parseHeader(std::string_view data, Span line);
+  void _finishHead(std::string_view data);
+  void _parseChunkSize(std::string_view data, Span line);
+
+  // turn the stored offsets into views into data
+  void _complete(std::string_view data);
+
+  State _state = State::RequestLine;
+  // everything before _offset has been parsed
+  size_t _offset = 0;
+  // where the line search continues, past _offset when a line is split
+  // over several calls
+  size_t _scanned = 0;
+
+  Span _path{};
+  Span _version{};
+  std::vector<std::pair<Span, Span>> _headerSpans;
+  std::vector<Span> _bodySpans;
+
+  size_t _maxBodySize;
+  bool _hasContentLength = false;
+  bool _isChunked = false;
+  // bytes left in the current chunk or Content-Length body
+  size_t _remaining = 0;
+  // sum of the chunk sizes so far
+  size_t _chunkedSize = 0;
+
+  RequestHead _head;
+  std::vector<std::string_view> _bodyParts;
+};
+} // namespace qabot::http
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace qabot::json_reader {
+// On-demand JSON reader. It walks the text once, front to back, and only
+// looks at what the caller asks for: fields the caller doesn't want are
+// skipped without being decoded, and strings come back as views of their
+// still escaped contents in the input, so nothing is copied or allocated.
+//
+//   JsonReader reader(body);
+//   reader.beginObject();
+//   while (auto key = reader.nextKey()) {
+//     if (*key == "name") name = reader.string(); else reader.skip();
+//   }
+//   reader.end();
+//
+// The views stay valid as long as the input does. Use appendUnescaped for
+// the few strings that are needed as plain text. Malformed input throws
+// std::runtime_error.
+class JsonReader {
+public:
+  enum class Type {
+    Object,
+    Array,
+    String,
+    Number,
+    Bool,
+    Null,
+  };
+
+  explicit JsonReader(std::string_view json) : _json(json) {}
+
+  // type of the next value
+  Type peek();
+
+  void beginObject();
+  // key of the next member of the current object, nothing once the object
+  // ended. The member's value has to be read or skipped before the next
+  // call.
+  std::optional<std::string_view> nextKey();
+
+  void beginArray();
+  // true if the current array has another element to read or skip
+  bool nextElement();
+
+  // contents of the next value, which has to be a string, still escaped
+  std::string_view string();
+
+  // skip the next value, containers included
+  void skip();
+
+  // the document has to be over, only whitespace may follow
+  void end();
+
+private:
+  void _skipWhitespace();
+  // consume c after optional whitespace, throws if something else is there
+  void _expect(char c);
+  // the string starting at the current '"', validates its escapes
+  std::string_view _string();
+  void _skipScalar();
+
+  [[noreturn]] void _fail(std::string_view reason) const;
+
+  std::string_view _json;
+  size_t _pos = 0;
+  // false once the current container had an element, the next one needs a
+  // comma in front
+  bool _isFirst = true;
+};
+
+// Appends the plain text of escaped string contents as returned by
+// JsonReader::string(), \uXXXX escapes (surrogate pairs included) become
+// UTF-8
+void appendUnescaped(std::pmr::string &output, std::string_view escaped);
+} // namespace qabot::json_reader
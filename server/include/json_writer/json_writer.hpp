@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+namespace qabot::json_writer {
+// Writes JSON text straight into an output string, without building a DOM
+// first. Commas and colons are placed automatically, the caller only opens
+// and closes containers and passes keys and values in document order:
+//
+//   JsonWriter writer(body);
+//   writer.beginObject().member("role", "user").endObject();
+//
+// Nesting is limited to kMaxDepth levels, the writer doesn't check that
+// containers are closed in the right order.
+class JsonWriter {
+public:
+  static constexpr size_t kMaxDepth = 64;
+
+  explicit JsonWriter(std::pmr::string &output) : _output(output) {}
+
+  JsonWriter(const JsonWriter &) = delete;
+  JsonWriter &operator=(const JsonWriter &) = delete;
+
+  JsonWriter &beginObject() { return _open('{'); }
+  JsonWriter &endObject() { return _close('}'); }
+  JsonWriter &beginArray() { return _open('['); }
+  JsonWriter &endArray() { return _close(']'); }
+
+  // the next value belongs to this key
+  JsonWriter &key(std::string_view key);
+
+  JsonWriter &string(std::string_view value);
+
+  // a string whose contents are already escaped, e.g. taken from a
+  // JsonReader, copied without looking at it again
+  JsonWriter &escapedString(std::string_view value);
+
+  // "key": "value"
+  JsonWriter &member(std::string_view key, std::string_view value) {
+    return this->key(key).string(value);
+  }
+
+private:
+  JsonWriter &_open(char bracket);
+  JsonWriter &_close(char bracket);
+
+  // a comma before every element of a container but the first
+  void _separate();
+
+  std::pmr::string &_output;
+  // one bit per open container, set once it has an element
+  uint64_t _hasElements = 0;
+  size_t _depth = 0;
+  bool _isAfterKey = false;
+};
+
+// Appends data as the inside of a JSON string literal. Quotes, backslashes
+// and control characters are escaped, everything else (including UTF-8) is
+// copied as is. The search for the next character to escape looks at 16
+// (SSE2) or 32 (AVX2) bytes at a time, so plain text is copied in one go.
+void appendEscaped(std::pmr::string &output, std::string_view data);
+
+// offset of the first quote, backslash or control character at or after
+// from, std::string_view::npos if there is none. Uses the same search as
+// appendEscaped.
+size_t findEscape(std::string_view data, size_t from = 0);
+} // namespace qabot::json_writer
@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace qabot::metrics {
+// Process-wide named counters, rendered in the Prometheus text format for
+// GET /metrics. Looking a counter up takes a lock, so callers look it up once
+// and keep the reference, updating it is a single atomic operation.
+class Metrics {
+public:
+  // singleton
+  static Metrics &getInstance() {
+    static Metrics instance;
+    return instance;
+  }
+
+  Metrics(const Metrics &) = delete;
+  Metrics &operator=(const Metrics &) = delete;
+  Metrics(Metrics &&) = delete;
+  Metrics &operator=(Metrics &&) = delete;
+
+  // Created on first use and never removed, the reference stays valid for
+  // the whole program. Also used for gauges, which can go down again.
+  std::atomic_int64_t &counter(std::string_view name) {
+    std::lock_guard<std::mutex> lock(_metricsMutex);
+    auto &value = _counters[std::string(name)];
+    if (!value) {
+      value = std::make_unique<std::atomic_int64_t>(0);
+    }
+    return *value;
+  }
+
+  std::string render() {
+    std::stringstream metricsStream;
+    std::lock_guard<std::mutex> lock(_metricsMutex);
+    for (const auto &[name, value] : _counters) {
+      metricsStream << name << " " << value->load(std::memory_order_relaxed)
+                    << "\n";
+    }
+    return metricsStream.str();
+  }
+
+private:
+  Metrics() = default;
+
+  // ordered so the output is stable
+  std::map<std::string, std::unique_ptr<std::atomic_int64_t>> _counters;
+
+  std::mutex _metricsMutex;
+};
+} // namespace qabot::metrics
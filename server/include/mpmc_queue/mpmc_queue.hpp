@@ -0,0 +1,142 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace qabot::mpmc_queue {
+// size of the slot every index counter gets to itself, so producers bumping
+// the tail don't invalidate the cache line consumers read the head from
+inline constexpr size_t kCacheLineSize = 64;
+
+// Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's
+// ring buffer). Every cell carries a sequence number telling producers and
+// consumers whose turn it is, so a push or pop is a single CAS on the shared
+// index plus one store on the cell.
+template <typename T> class MpmcQueue {
+public:
+  // capacity is rounded up to the next power of two
+  explicit MpmcQueue(size_t capacity = 1024)
+      : _capacity(_roundUpToPowerOfTwo(capacity)), _mask(_capacity - 1),
+        _cells(std::make_unique<Cell[]>(_capacity)) {
+    for (size_t i = 0; i < _capacity; ++i) {
+      _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~MpmcQueue() {
+    while (tryPop().has_value()) {
+    }
+  }
+
+  MpmcQueue(const MpmcQueue &) = delete;
+  MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+  bool tryPush(const T &value) { return _tryEmplace(value); }
+  bool tryPush(T &&value) { return _tryEmplace(std::move(value)); }
+
+  // blocks (yielding) while the queue is full
+  void push(const T &value) {
+    while (!_tryEmplace(value)) {
+      std::this_thread::yield();
+    }
+  }
+  void push(T &&value) {
+    while (!_tryEmplace(std::move(value))) {
+      std::this_thread::yield();
+    }
+  }
+
+  std::optional<T> tryPop() {
+    size_t position = _head.value.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &_cells[position & _mask];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const auto difference = static_cast<std::ptrdiff_t>(sequence) -
+                              static_cast<std::ptrdiff_t>(position + 1);
+      if (difference == 0) {
+        if (_head.value.compare_exchange_weak(position, position + 1,
+                                              std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // the producer for this slot hasn't published yet, queue is empty
+        return std::nullopt;
+      } else {
+        position = _head.value.load(std::memory_order_relaxed);
+      }
+    }
+
+    std::optional<T> value{std::move(*cell->get())};
+    cell->get()->~T();
+    // hand the slot over to the producer one lap ahead
+    cell->sequence.store(position + _capacity, std::memory_order_release);
+    return value;
+  }
+
+  // only a snapshot, other threads may push or pop right after
+  bool empty() const {
+    return _head.value.load(std::memory_order_acquire) >=
+           _tail.value.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const { return _capacity; }
+
+private:
+  struct Cell {
+    std::atomic_size_t sequence;
+    alignas(T) unsigned char storage[sizeof(T)];
+
+    T *get() { return std::launder(reinterpret_cast<T *>(storage)); }
+  };
+
+  struct alignas(kCacheLineSize) PaddedIndex {
+    std::atomic_size_t value{0};
+  };
+
+  template <typename U> bool _tryEmplace(U &&value) {
+    size_t position = _tail.value.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &_cells[position & _mask];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const auto difference = static_cast<std::ptrdiff_t>(sequence) -
+                              static_cast<std::ptrdiff_t>(position);
+      if (difference == 0) {
+        if (_tail.value.compare_exchange_weak(position, position + 1,
+                                              std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // the consumer one lap behind still owns this slot, queue is full
+        return false;
+      } else {
+        position = _tail.value.load(std::memory_order_relaxed);
+      }
+    }
+
+    new (cell->storage) T(std::forward<U>(value));
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  static size_t _roundUpToPowerOfTwo(size_t value) {
+    size_t result = 2;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  const size_t _capacity;
+  const size_t _mask;
+  std::unique_ptr<Cell[]> _cells;
+
+  PaddedIndex _head;
+  PaddedIndex _tail;
+};
+} // namespace qabot::mpmc_queue
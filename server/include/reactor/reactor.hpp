@@ -0,0 +1,169 @@
+#pragma once
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "event_manager/event_manager.hpp"
+#include "timer_wheel/timer_wheel.hpp"
+
+namespace qabot::reactor {
+#ifdef _WIN32
+using NativeHandle = SOCKET;
+#else
+using NativeHandle = int;
+#endif
+
+enum class Interest {
+  Read,
+  Write,
+};
+
+using Clock = timer_wheel::Clock;
+
+// a watch without a deadline waits for as long as it takes
+inline constexpr Clock::time_point kNoDeadline = Clock::time_point::max();
+
+// callback waiting for a handle or a point in time, queued back on the
+// worker that registered it. The reactor links it into its timer wheel
+// while it has a deadline, so it must stay where it is until it fired or
+// was cancelled.
+struct Waiter : timer_wheel::Timer {
+  event_manager::Event onReady;
+  size_t workerIndex = 0;
+};
+
+// The reactor waits for socket readiness on its own thread and hands the
+// registered callbacks over to the EventManager once the kernel reports that
+// the handle can make progress. Callbacks run on the worker that registered
+// them. Every watch is one-shot: after the callback
+// has been queued the caller has to watch the handle again if it still needs
+// to wait. Entries are kept after they fire, so waiting on a socket that was
+// watched before doesn't allocate.
+//
+// A watch can carry a deadline, its callback is then queued at the deadline
+// even if the handle never became ready. The callback retries its operation
+// either way and tells the two cases apart by looking at the clock.
+// Deadlines and plain timers share one timer wheel that the poll loop
+// advances, so arming and cancelling them is O(1).
+class Reactor {
+public:
+  // singleton
+  static Reactor &getInstance() {
+    static Reactor instance;
+    return instance;
+  }
+
+  Reactor(const Reactor &) = delete;
+  Reactor &operator=(const Reactor &) = delete;
+  Reactor(Reactor &&) = delete;
+  Reactor &operator=(Reactor &&) = delete;
+
+  void watch(NativeHandle handle, Interest interest,
+             event_manager::Event onReady,
+             Clock::time_point deadline = kNoDeadline);
+
+  // queue onReady once deadline passed, waiter has to outlive the timer
+  void schedule(Waiter &waiter, Clock::time_point deadline,
+                event_manager::Event onReady);
+  // take back a timer from schedule that may not have fired yet
+  void cancel(Waiter &waiter);
+
+  // Readiness learned from somewhere else than the kernel's readiness
+  // reports, like an io_uring completion. Wakes the watch of handle for
+  // interest, or the next one if nobody is waiting right now, so a
+  // completion that arrives between a failed attempt and its watch isn't
+  // lost. A stale notification only costs a retry.
+  void notify(NativeHandle handle, Interest interest);
+
+  // Readiness of handle only comes through notify from now on, e.g. for a
+  // socket driven by io_uring completions, so watch doesn't ask the kernel
+  // about it. Turn it off before the handle is closed, its number is reused.
+  void setNotifyOnly(NativeHandle handle, bool isNotifyOnly);
+
+private:
+  // a callback taken from its waiter, ready to be queued
+  struct Wakeup {
+    event_manager::Event onReady;
+    size_t workerIndex;
+  };
+
+  struct Watch {
+    Waiter readable;
+    Waiter writable;
+    // notified while nobody was waiting, the next watch fires right away
+    bool isReadableNotified = false;
+    bool isWritableNotified = false;
+    // see setNotifyOnly
+    bool isNotifyOnly = false;
+  };
+
+  Reactor();
+  ~Reactor();
+
+  void _pollLoop();
+
+  // take the callbacks that became ready, must be called with _watchMutex
+  // held
+  void _collectReady(NativeHandle handle, bool readable, bool writable,
+                     std::vector<Wakeup> &ready);
+
+  // take the callbacks whose deadline passed, returns when the poll has to
+  // wake up next. Must be called with _watchMutex held.
+  Clock::time_point _collectExpired(std::vector<Wakeup> &ready);
+
+  // disarm waiter and move its callback to ready
+  void _take(Waiter &waiter, std::vector<Wakeup> &ready);
+
+  // take the waiter that was just registered for interest if a notify came
+  // first, returns whether it was taken
+  bool _takeNotified(Watch &watch, Interest interest,
+                     std::vector<Wakeup> &ready);
+
+  // set up waiter on the calling worker, with _watchMutex held. Returns
+  // whether the poll thread sleeps past the deadline and has to be woken.
+  bool _register(Waiter &waiter, event_manager::Event onReady,
+                 Clock::time_point deadline);
+
+  // queue the callbacks on their workers and empty ready
+  static void _dispatch(std::vector<Wakeup> &ready);
+
+  // interrupt the poll thread's wait so it looks at the deadlines again
+  void _wake();
+
+  std::unordered_map<NativeHandle, Watch> _watches;
+
+  // deadlines of the watches and the scheduled timers
+  timer_wheel::TimerWheel _timers;
+  // when the poll thread wakes up on its own, needs _watchMutex
+  Clock::time_point _pollWakeUp = kNoDeadline;
+
+  std::mutex _watchMutex;
+
+  std::thread _pollThread;
+
+  std::atomic_bool _isRunning{true};
+
+#ifdef __linux__
+  void _arm(NativeHandle handle, const Watch &watch);
+
+  int _epollFd = -1;
+  // eventfd used to interrupt epoll_wait on shutdown and for earlier
+  // deadlines
+  int _wakeFd = -1;
+#else
+  // number of handles somebody is waiting on, needs _watchMutex
+  size_t _waitingCount() const;
+
+  // portable fallback, the poll thread sleeps here while nothing is watched
+  std::condition_variable _watchCondition;
+#endif
+};
+} // namespace qabot::reactor
@@ -1,19 +1,46 @@
 #pragma once
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
 #include "task/task.hpp"
 #ifdef _WIN32
 #include "socket/windows_socket_impl.hpp"
 using SocketImpl = qabot::socket::WindowsSocketImpl;
+#elif defined(QABOT_IO_URING)
+#include "socket/uring_socket_impl.hpp"
+using SocketImpl = qabot::socket::UringSocketImpl;
 #else
 #include "socket/unix_socket_impl.hpp"
 using SocketImpl = qabot::socket::UnixSocketImpl;
 #endif
 
 namespace qabot::server {
+// How long each phase of a request may take, counted from the start of the
+// phase. A phase that runs over fails with std::errc::timed_out and takes
+// the connection down with it.
+struct Timeouts {
+  // TCP connect to the AI server
+  std::chrono::milliseconds connect = std::chrono::seconds(10);
+  std::chrono::milliseconds tlsHandshake = std::chrono::seconds(10);
+  // from the request being sent until the response's status line arrived
+  std::chrono::milliseconds firstByte = std::chrono::seconds(60);
+  // each later read of the response: a header line, a chunk, the body
+  std::chrono::milliseconds upstreamIdle = std::chrono::seconds(30);
+  // a keep-alive client sending its next request
+  std::chrono::milliseconds clientIdle = std::chrono::seconds(60);
+};
+
 class Server {
  public:
-  Server()
-      : _serverSocket(qabot::socket::TransportProtocol::TCP,
-                      qabot::socket::IPVersion::IPv4) {}
+  static constexpr size_t kDefaultMaxRequestSize = 1024 * 1024;
+  static constexpr size_t kDefaultMaxKeepAliveRequests = 1000;
+  static constexpr int kDefaultListenBacklog = 1024;
+  // connections taken off a listen queue before going back to the reactor
+  static constexpr size_t kAcceptBatchSize = 64;
+
+  Server() = default;
   // singleton
   static Server& getInstance() {
     static Server instance;
@@ -27,11 +54,48 @@ class Server {
   Server& operator=(Server&&) = delete;
   void start();
 
+  // Upper bound for one buffered client request, head and body. A client
+  // sending more gets an error and is disconnected.
+  static void setMaxRequestSize(size_t maxRequestSize) {
+    _maxRequestSize = maxRequestSize;
+  }
+
+  static void setTimeouts(const Timeouts& timeouts) { _timeouts = timeouts; }
+
+  // How many requests a keep-alive connection may send before the server
+  // closes it after the response
+  static void setMaxKeepAliveRequests(size_t maxKeepAliveRequests) {
+    _maxKeepAliveRequests = maxKeepAliveRequests;
+  }
+
+  static void setListenBacklog(int listenBacklog) {
+    _listenBacklog = listenBacklog;
+  }
+
+  // 0 keeps a single listener whose connections go to any worker. Otherwise
+  // every event loop worker gets this many SO_REUSEPORT listeners of its
+  // own, the kernel spreads the connections across them and a connection
+  // stays on the worker that accepted it.
+  static void setListenersPerWorker(size_t listenersPerWorker) {
+    _listenersPerWorker = listenersPerWorker;
+  }
+
  private:
-  qabot::task::Task<void> _serverLoop();
-  qabot::task::Task<void> _clientLoop(
+  using ServerSocket = qabot::socket::Socket<SocketImpl>;
+
+  ServerSocket& _listen(bool isSharded);
+  qabot::task::DetachedTask _serverLoop(ServerSocket& listener,
+                                        size_t workerIndex);
+  void _acceptBatch(ServerSocket& listener);
+  qabot::task::DetachedTask _clientLoop(
       qabot::socket::Socket<SocketImpl>&& clientSocket);
 
-  qabot::socket::Socket<SocketImpl> _serverSocket;
+  std::vector<std::unique_ptr<ServerSocket>> _listeners;
+
+  static inline size_t _maxRequestSize = kDefaultMaxRequestSize;
+  static inline Timeouts _timeouts;
+  static inline size_t _maxKeepAliveRequests = kDefaultMaxKeepAliveRequests;
+  static inline int _listenBacklog = kDefaultListenBacklog;
+  static inline size_t _listenersPerWorker = 0;
 };
 }  // namespace qabot::server
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include <string>
+
+namespace qabot::socket {
+// A resolved IPv4 or IPv6 address and port, ready to be handed to connect
+struct Endpoint {
+  sockaddr_storage address{};
+  socklen_t length = 0;
+
+  int port() const {
+    if (address.ss_family == AF_INET6) {
+      return ntohs(reinterpret_cast<const sockaddr_in6 *>(&address)->sin6_port);
+    }
+    return ntohs(reinterpret_cast<const sockaddr_in *>(&address)->sin_port);
+  }
+
+  std::string toString() const {
+    char ipStr[INET6_ADDRSTRLEN] = "?";
+    if (address.ss_family == AF_INET6) {
+      inet_ntop(AF_INET6,
+                &reinterpret_cast<const sockaddr_in6 *>(&address)->sin6_addr,
+                ipStr, sizeof(ipStr));
+      return "[" + std::string(ipStr) + "]:" + std::to_string(port());
+    }
+    inet_ntop(AF_INET,
+              &reinterpret_cast<const sockaddr_in *>(&address)->sin_addr,
+              ipStr, sizeof(ipStr));
+    return std::string(ipStr) + ":" + std::to_string(port());
+  }
+};
+} // namespace qabot::socket
@@ -0,0 +1,53 @@
+#pragma once
+#include <expected>
+#include <string>
+#include <system_error>
+
+namespace qabot::socket {
+// Error codes raised by the socket layer when an operation cannot make
+// progress until the underlying handle becomes readable or writable again.
+// Both compare equal to std::errc::operation_would_block, so callers that
+// only care about "would block" don't need to know about them.
+enum class IoErrc {
+  WantRead = 1,
+  WantWrite = 2,
+};
+
+class IoCategory : public std::error_category {
+public:
+  const char *name() const noexcept override { return "qabot.io"; }
+
+  std::string message(int value) const override {
+    switch (static_cast<IoErrc>(value)) {
+    case IoErrc::WantRead:
+      return "Operation would block until the socket is readable";
+    case IoErrc::WantWrite:
+      return "Operation would block until the socket is writable";
+    default:
+      return "Unknown I/O error";
+    }
+  }
+
+  std::error_condition
+  default_error_condition(int) const noexcept override {
+    return std::make_error_condition(std::errc::operation_would_block);
+  }
+};
+
+inline const std::error_category &ioCategory() {
+  static IoCategory category;
+  return category;
+}
+
+inline std::error_code make_error_code(IoErrc errc) {
+  return {static_cast<int>(errc), ioCategory()};
+}
+
+// Result of a non-blocking socket operation: its value, or the readiness to
+// wait for before trying again. Not being ready is ordinary flow control and
+// returned, only real failures are thrown.
+template <typename T> using IoResult = std::expected<T, IoErrc>;
+} // namespace qabot::socket
+
+template <>
+struct std::is_error_code_enum<qabot::socket::IoErrc> : std::true_type {};
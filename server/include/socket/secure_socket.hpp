@@ -1,107 +1,337 @@
 #pragma once
 
+#include <openssl/bio.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
+#include "buffer_pool/buffer_pool.hpp"
+#include "io_error.hpp"
 #include "socket.hpp"
+#include "tls_context.hpp"
 #include <cerrno>
 #include <cstring>
 #include <exception>
+#include <iostream>
+#include <memory>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <system_error>
 #include <vector>
 
 namespace qabot::socket {
+// TLS client connection on top of any socket implementation. OpenSSL never
+// touches the socket, it reads and writes two memory BIOs:
+//
+// - ciphertext is received from the socket in chunks of up to
+//   kCiphertextChunk bytes, which usually holds several TLS records, and
+//   OpenSSL decrypts them one after the other without another receive
+// - whatever OpenSSL produced (records, handshake messages, alerts) is sent
+//   as one block after each call, what the socket doesn't take stays queued
+//   and goes out first on the next call
+//
+// Every call runs OpenSSL until it is done or needs ciphertext the socket
+// doesn't have yet, SSL_ERROR_WANT_READ / SSL_ERROR_WANT_WRITE turn into
+// the readiness of the socket to wait for. The handshake is driven the same
+// way, so it advances one flight per readiness event.
+//
+// With TlsContext::isKernelTls the connection goes the other way: OpenSSL
+// gets the socket itself so it can hand the record layer to the kernel after
+// the handshake. Reads and writes then go straight to the socket, and the
+// memory BIOs are never created.
 template <SocketImplConcept SocketImpl> class SecureSocket {
 public:
+  // ciphertext taken off the socket per receive
+  static constexpr size_t kCiphertextChunk =
+      buffer_pool::BufferPool::kSizeClasses.back();
+  // ciphertext queued for the socket before send reports would-block
+  static constexpr size_t kMaxQueuedCiphertext = 256 * 1024;
+
   SecureSocket(TransportProtocol protocol, IPVersion ipVersion)
       : _socket(protocol, ipVersion) {
-    // Initialize OpenSSL
-    SSL_load_error_strings();
-    // Load all algorithms
-    OpenSSL_add_ssl_algorithms();
-    _sslContext = SSL_CTX_new(TLS_method());
-    if (!_sslContext) {
-      throw std::runtime_error("Failed to create SSL context");
-    }
-    // forbid SSLv2 to avoid security issues
-    SSL_CTX_set_options(_sslContext, SSL_OP_NO_SSLv2);
-    // Create a new SSL structure for the connection
-    _ssl = SSL_new(_sslContext);
-    if (!_ssl) {
-      throw std::runtime_error("Failed to create SSL structure");
-    }
-  } 
+    // Create a new SSL structure for the connection, the context is shared
+    // so sessions can be resumed
+    _ssl = TlsContext::getInstance().newSsl();
+    if (TlsContext::isKernelTls()) {
+      _isKernelTls = true;
+      if (!SSL_set_fd(_ssl, static_cast<int>(_socket.getSocketFD()))) {
+        SSL_free(_ssl);
+        throw std::runtime_error("Failed to attach TLS to the socket");
+      }
+      return;
+    }
+    // the SSL owns both BIOs from here on
+    _readBio = BIO_new(BIO_s_mem());
+    _writeBio = BIO_new(BIO_s_mem());
+    if (!_readBio || !_writeBio) {
+      BIO_free(_readBio);
+      BIO_free(_writeBio);
+      SSL_free(_ssl);
+      throw std::runtime_error("Failed to create TLS buffers");
+    }
+    SSL_set_bio(_ssl, _readBio, _writeBio);
+  }
 
   ~SecureSocket() {
+    // OpenSSL throws away the session of a connection that was never shut
+    // down, send close_notify (best effort, the socket is non-blocking) so it
+    // can be resumed
+    if (SSL_is_init_finished(_ssl)) {
+      SSL_shutdown(_ssl);
+      ERR_clear_error();
+      try {
+        (void)_flush();
+      } catch (const std::exception &) {
+        // the connection is going away anyway
+      }
+    }
     SSL_free(_ssl);
-    SSL_CTX_free(_sslContext);
-  }
-
-  void connect(const std::string &host, int port) {
-    SSL_set_fd(_ssl, _socket.getSocketFD());
-    _socket.connect(host, port);
-    ERR_clear_error();
-    auto ret = SSL_connect(_ssl);
-
-    if (ret <= 0) {
-      if (SSL_get_error(_ssl, ret) == SSL_ERROR_WANT_WRITE ||
-          SSL_get_error(_ssl, ret) == SSL_ERROR_WANT_READ) {
-        // Handle non-blocking connect
-        throw std::system_error{
-            static_cast<int>(std::errc::operation_would_block),
-            std::generic_category(), "Non-blocking connect would block"};
-      } else {
-        std::cerr << "SSL error: " << SSL_get_error(_ssl, ret) << std::endl;
-        throw std::runtime_error("Failed to establish SSL connection");
+  }
+
+  IoResult<void> connect(const std::string &host, int port) {
+    _prepareHandshake(host, port);
+    if (auto connected = _socket.connect(host, port); !connected) {
+      return connected;
+    }
+    return _handshake();
+  }
+
+  // connect to an address resolved beforehand, host is still needed for SNI
+  // and to find a session to resume
+  IoResult<void> connect(const std::string &host, const Endpoint &endpoint) {
+    if (auto connected = connectTransport(host, endpoint); !connected) {
+      return connected;
+    }
+    return _handshake();
+  }
+
+  // the two halves of connect, for callers that give each its own deadline.
+  // Both are retried until they succeed, like connect.
+  IoResult<void> connectTransport(const std::string &host,
+                                  const Endpoint &endpoint) {
+    _prepareHandshake(host, endpoint.port());
+    return _socket.connect(endpoint);
+  }
+  IoResult<void> handshake() { return _handshake(); }
+
+  // returns how much of data OpenSSL took, partial writes are enabled on
+  // the shared context so this can be less than data.size()
+  IoResult<size_t> send(std::string_view data) {
+    if (auto flushed = _flush();
+        !flushed && _queuedCiphertext() >= kMaxQueuedCiphertext) {
+      // the peer isn't reading, stop encrypting more for it
+      return std::unexpected(flushed.error());
+    }
+    auto result = _run([this, data]() {
+      return SSL_write(_ssl, data.data(), static_cast<int>(data.size()));
+    });
+    if (!result) {
+      return std::unexpected(result.error());
+    }
+    if (result->ret <= 0) {
+      long error_code = ERR_get_error();
+      char err_buf[256];
+      ERR_error_string_n(error_code, err_buf, sizeof(err_buf));
+      std::cerr << "SSL_write error: " << result->error
+                << ", OpenSSL error: " << err_buf << std::endl;
+      throw std::runtime_error(std::string("Failed to send data over SSL: ") +
+                               err_buf);
+    }
+    // the records are queued even if the socket didn't take all of them
+    return static_cast<size_t>(result->ret);
+  }
+
+  // TLS has no gather write, every call writes the first buffer with data
+  IoResult<size_t> sendv(std::span<const std::string_view> buffers) {
+    for (auto buffer : buffers) {
+      if (!buffer.empty()) {
+        return send(buffer);
       }
     }
+    return 0;
+  }
+
+  IoResult<std::string> receive(size_t size) {
+    // receiveSome may throw, which resize_and_overwrite doesn't allow, so
+    // read into an uninitialized buffer instead
+    auto buffer = std::make_unique_for_overwrite<char[]>(size);
+    auto bytesReceived = receiveSome(buffer.get(), size);
+    if (!bytesReceived) {
+      return std::unexpected(bytesReceived.error());
+    }
+    if (*bytesReceived == 0) {
+      throw std::runtime_error("Failed to receive data over SSL");
+    }
+    return std::string(buffer.get(), *bytesReceived);
+  }
+
+  // Reads up to size bytes of plaintext straight into the caller's buffer,
+  // returns 0 once the peer closed the TLS session
+  IoResult<size_t> receiveSome(char *data, size_t size) {
+    auto result = _run([this, data, size]() {
+      return SSL_read(_ssl, data, static_cast<int>(size));
+    });
+    if (!result) {
+      return std::unexpected(result.error());
+    }
+    if (result->ret > 0) {
+      return static_cast<size_t>(result->ret);
+    }
+    if (result->error == SSL_ERROR_ZERO_RETURN) {
+      return 0;
+    }
+    std::cerr << "SSL error: " << result->error << std::endl;
+    throw std::runtime_error("Failed to receive data over SSL");
+  }
+
+  // Checks an idle connection without blocking. Records that arrived in the
+  // meantime, like session tickets, are processed on the way. A close from
+  // the peer or unexpected application data means it can't be reused.
+  bool isIdleAlive() {
+    char byte;
+    try {
+      auto result =
+          _run([this, &byte]() { return SSL_peek(_ssl, &byte, 1); });
+      // nothing to read is what an idle connection looks like
+      return !result && result.error() == IoErrc::WantRead;
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+
+  auto getSocketFD() const { return _socket.getSocketFD(); }
+
+private:
+  // an OpenSSL call's return value and what SSL_get_error made of it
+  struct CallResult {
+    int ret;
+    int error;
+  };
+
+  void _prepareHandshake(const std::string &host, int port) {
+    // connect is retried until the handshake finishes, set up only once
+    if (_sessionKey.empty()) {
+      _sessionKey = host + ":" + std::to_string(port);
+      TlsContext::getInstance().prepare(_ssl, host, _sessionKey);
+    }
+  }
+
+  IoResult<void> _handshake() {
+    auto result = _run([this]() { return SSL_connect(_ssl); });
+    if (!result) {
+      return std::unexpected(result.error());
+    }
+    if (result->ret <= 0) {
+      std::cerr << "SSL error: " << result->error << std::endl;
+      throw std::runtime_error("Failed to establish SSL connection");
+    }
+    TlsContext::getInstance().handshakeDone(_ssl);
+    return {};
   }
 
-  void send(const std::string &data) {
-    ERR_clear_error();
-    auto ret = SSL_write(_ssl, data.c_str(), data.size());
-    if (ret <= 0) {
-      if (SSL_get_error(_ssl, ret) == SSL_ERROR_WANT_WRITE ||
-          SSL_get_error(_ssl, ret) == SSL_ERROR_WANT_READ) {
-        // Handle non-blocking write
-        throw std::system_error{
-            static_cast<int>(std::errc::operation_would_block),
-            std::generic_category(), "Non-blocking write would block"};
-      } else {
-        long error_code = ERR_get_error();
-        char err_buf[256];
-        ERR_error_string_n(error_code, err_buf, sizeof(err_buf));
-        std::cerr << "SSL_write error: " << SSL_get_error(_ssl, ret)
-                  << ", OpenSSL error: " << err_buf << std::endl;
-        throw std::runtime_error(std::string("Failed to send data over SSL: ") +
-                                 err_buf);
+  // Runs an OpenSSL call until it no longer waits on the memory BIOs. What
+  // the call wrote is flushed to the socket, the ciphertext it is missing is
+  // received from it. Returns the finished call, or the readiness to wait
+  // for when the socket has nothing for it.
+  template <typename Call> IoResult<CallResult> _run(Call call) {
+    while (true) {
+      ERR_clear_error();
+      int ret = call();
+      // ask right away, flushing moves the BIOs' retry flags
+      int error = ret > 0 ? SSL_ERROR_NONE : SSL_get_error(_ssl, ret);
+      if (_isKernelTls) {
+        // OpenSSL talks to the socket itself, its retry is the readiness
+        if (error == SSL_ERROR_WANT_READ) {
+          return std::unexpected(IoErrc::WantRead);
+        }
+        if (error == SSL_ERROR_WANT_WRITE) {
+          return std::unexpected(IoErrc::WantWrite);
+        }
+        return CallResult{ret, error};
+      }
+      auto flushed = _flush();
+
+      if (error == SSL_ERROR_WANT_READ) {
+        if (!flushed) {
+          // the peer may be waiting for what we couldn't send yet
+          return std::unexpected(IoErrc::WantWrite);
+        }
+        if (auto received = _receiveCiphertext(); !received) {
+          return std::unexpected(received.error());
+        }
+        continue;
       }
+      if (error == SSL_ERROR_WANT_WRITE) {
+        if (!flushed) {
+          return std::unexpected(flushed.error());
+        }
+        continue;
+      }
+      return CallResult{ret, error};
+    }
+  }
+
+  // one receive of ciphertext into the read BIO. At the end of the stream
+  // the BIO reports end of file, the next OpenSSL call fails or sees the
+  // close_notify.
+  IoResult<void> _receiveCiphertext() {
+    auto buffer =
+        buffer_pool::BufferPool::getInstance().acquire(kCiphertextChunk);
+    auto bytesReceived = _socket.receiveSome(buffer.data(), buffer.size());
+    if (!bytesReceived) {
+      return std::unexpected(bytesReceived.error());
+    }
+    if (*bytesReceived == 0) {
+      BIO_set_mem_eof_return(_readBio, 0);
+      return {};
     }
+    BIO_write(_readBio, buffer.data(), static_cast<int>(*bytesReceived));
+    return {};
   }
 
-  std::string receive(size_t size) {
-    std::vector<char> buffer(size);
-    ERR_clear_error();
-    int ret = SSL_read(_ssl, buffer.data(), size);
-    if (ret <= 0) {
-      if (SSL_get_error(_ssl, ret) == SSL_ERROR_WANT_READ ||
-          SSL_get_error(_ssl, ret) == SSL_ERROR_WANT_WRITE) {
-        // Handle non-blocking read
-        throw std::system_error{
-            static_cast<int>(std::errc::operation_would_block),
-            std::generic_category(), "Non-blocking read would block"};
-      } else {
-        std::cerr << "SSL error: " << SSL_get_error(_ssl, ret) << std::endl;
-        throw std::runtime_error("Failed to receive data over SSL");
+  // Moves what OpenSSL wrote into the queue and sends the queue, returns
+  // the would-block status when the socket didn't take all of it
+  IoResult<void> _flush() {
+    if (_isKernelTls) {
+      // OpenSSL wrote to the socket itself
+      return {};
+    }
+    if (auto pending = BIO_ctrl_pending(_writeBio); pending > 0) {
+      auto offset = _ciphertext.size();
+      _ciphertext.resize(offset + pending);
+      BIO_read(_writeBio, _ciphertext.data() + offset,
+               static_cast<int>(pending));
+    }
+    while (_sentCiphertext < _ciphertext.size()) {
+      std::string_view rest(_ciphertext);
+      rest.remove_prefix(_sentCiphertext);
+      auto sent = _socket.sendv({&rest, 1});
+      if (!sent) {
+        return std::unexpected(sent.error());
       }
+      _sentCiphertext += *sent;
     }
-    return std::string(buffer.data(), ret);
+    _ciphertext.clear();
+    _sentCiphertext = 0;
+    return {};
+  }
+
+  size_t _queuedCiphertext() const {
+    return _ciphertext.size() - _sentCiphertext;
   }
 
-private:
   SocketImpl _socket;
-  SSL_CTX *_sslContext;
   SSL *_ssl;
+  // OpenSSL has the socket, set up for kernel TLS
+  bool _isKernelTls = false;
+  // owned by _ssl: ciphertext from the peer, ciphertext for the peer
+  BIO *_readBio = nullptr;
+  BIO *_writeBio = nullptr;
+  // ciphertext taken out of the write BIO, sent up to _sentCiphertext
+  std::string _ciphertext;
+  size_t _sentCiphertext = 0;
+  // host:port, sessions of this connection are cached under it
+  std::string _sessionKey;
 };
-} // namespace qabot::socket
\ No newline at end of file
+} // namespace qabot::socket
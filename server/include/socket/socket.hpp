@@ -1,9 +1,14 @@
 #pragma once
 #include <concepts>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <utility>
 
+#include "endpoint.hpp"
+#include "io_error.hpp"
+
 namespace qabot::socket {
 enum class TransportProtocol {
   TCP,
@@ -18,7 +23,9 @@ struct ClientInfo {
   int port;
 };
 // This is a concept to check whether a type is a socket implementation
-// The type must have the following methods:
+// The type must have the following methods. The non-blocking ones return an
+// IoResult, a call that would block reports the readiness it waits for
+// instead of throwing.
 template <typename PlatformImpl>
 concept SocketImplConcept = requires(PlatformImpl platformImpl) {
   // Check if the constructor takes TransportProtocol and IPVersion
@@ -28,17 +35,33 @@ concept SocketImplConcept = requires(PlatformImpl platformImpl) {
 
   { platformImpl.init() } -> std::same_as<bool>;
 
-  { platformImpl.accept() } -> std::same_as<PlatformImpl>;
+  { platformImpl.accept() } -> std::same_as<IoResult<PlatformImpl>>;
   { platformImpl.listen(std::declval<int>()) };
-  { platformImpl.connect(std::declval<std::string>(), std::declval<int>()) };
+  { platformImpl.setReusePort() } -> std::same_as<bool>;
+  {
+    platformImpl.connect(std::declval<std::string>(), std::declval<int>())
+  } -> std::same_as<IoResult<void>>;
+  {
+    platformImpl.connect(std::declval<Endpoint>())
+  } -> std::same_as<IoResult<void>>;
   {
     platformImpl.sendTo(std::declval<std::string>(), std::declval<int>(),
                         std::declval<std::string>())
   };
-  { platformImpl.send(std::declval<std::string>()) };
+  {
+    platformImpl.send(std::declval<std::string>())
+  } -> std::same_as<IoResult<size_t>>;
+  {
+    platformImpl.sendv(std::declval<std::span<const std::string_view>>())
+  } -> std::same_as<IoResult<size_t>>;
   { platformImpl.bind(std::declval<std::string>(), std::declval<int>()) };
 
-  { platformImpl.receive(std::declval<size_t>()) } -> std::same_as<std::string>;
+  {
+    platformImpl.receive(std::declval<size_t>())
+  } -> std::same_as<IoResult<std::string>>;
+  {
+    platformImpl.receiveSome(std::declval<char *>(), std::declval<size_t>())
+  } -> std::same_as<IoResult<size_t>>;
   {
     platformImpl.receiveFrom(std::declval<size_t>())
   } -> std::same_as<std::pair<std::string, ClientInfo>>;
@@ -62,30 +85,49 @@ public:
         _ipVersion(platformImpl.getIPVersion()),
         _platformImpl(std::move(platformImpl)) {}
   ~Socket() { _platformImpl.close(); }
-  void connect(const std::string &serverName, const int port) {
-    _platformImpl.connect(serverName, port);
+  IoResult<void> connect(const std::string &serverName, const int port) {
+    return _platformImpl.connect(serverName, port);
+  }
+  IoResult<void> connect(const Endpoint &endpoint) {
+    return _platformImpl.connect(endpoint);
   }
   void sendTo(const std::string &serverName, const int port,
               const std::string &message) {
     _platformImpl.sendTo(serverName, port, message);
   }
-  void send(const std::string &message) { _platformImpl.send(message); }
+  IoResult<size_t> send(const std::string &message) {
+    return _platformImpl.send(message);
+  }
+  IoResult<size_t> sendv(std::span<const std::string_view> buffers) {
+    return _platformImpl.sendv(buffers);
+  }
 
   void bind(const std::string &serverName, const int port) {
     _platformImpl.bind(serverName, port);
   }
-  std::string receive(size_t bufferSize) {
+  IoResult<std::string> receive(size_t bufferSize) {
     return _platformImpl.receive(bufferSize);
   }
+  // reads into the caller's buffer, returns 0 once the peer closed the
+  // connection
+  IoResult<size_t> receiveSome(char *data, size_t size) {
+    return _platformImpl.receiveSome(data, size);
+  }
   std::pair<std::string, ClientInfo> receiveFrom(size_t bufferSize) {
     return _platformImpl.receiveFrom(bufferSize);
   }
-  Socket<PlatformImpl> accept() {
+  IoResult<Socket<PlatformImpl>> accept() {
     auto platformImpl = _platformImpl.accept();
-    return Socket<PlatformImpl>(platformImpl);
+    if (!platformImpl) {
+      return std::unexpected(platformImpl.error());
+    }
+    return Socket<PlatformImpl>(*platformImpl);
   }
   void listen(int backlog) { _platformImpl.listen(backlog); }
+  // before bind, returns false where the platform can't share a port
+  bool setReusePort() { return _platformImpl.setReusePort(); }
   void close() { _platformImpl.close(); }
+  auto getSocketFD() const { return _platformImpl.getSocketFD(); }
 
 private:
   TransportProtocol _protocol;
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "metrics/metrics.hpp"
+
+namespace qabot::socket {
+// The client SSL_CTX shared by every SecureSocket. Keeping one context alive
+// for the whole program is what lets connections resume TLS sessions: the
+// newest session ticket (or TLS 1.3 PSK) of every host:port is cached and
+// offered on the next handshake to that host, which then skips the
+// certificate exchange and key agreement.
+//
+// With kernel TLS switched on, connections are set up for OpenSSL's kTLS
+// offload: after the handshake the kernel encrypts and decrypts the records
+// and SSL_write / SSL_read become plain socket calls. Where the tls module or
+// the negotiated cipher isn't supported OpenSSL quietly stays in userspace,
+// the counters show which sessions were offloaded.
+class TlsContext {
+public:
+  // singleton
+  static TlsContext &getInstance() {
+    static TlsContext instance;
+    return instance;
+  }
+
+  TlsContext(const TlsContext &) = delete;
+  TlsContext &operator=(const TlsContext &) = delete;
+  TlsContext(TlsContext &&) = delete;
+  TlsContext &operator=(TlsContext &&) = delete;
+
+  // applies to the connections created afterwards, ignored where OpenSSL
+  // can't hand TLS to the kernel
+  static void setKernelTls(bool isEnabled) {
+#if defined(__linux__) && defined(SSL_OP_ENABLE_KTLS)
+    _isKernelTls = isEnabled;
+#endif
+  }
+  static bool isKernelTls() { return _isKernelTls; }
+
+  SSL *newSsl() {
+    auto ssl = SSL_new(_sslContext);
+    if (!ssl) {
+      throw std::runtime_error("Failed to create SSL structure");
+    }
+#ifdef SSL_OP_ENABLE_KTLS
+    if (_isKernelTls) {
+      SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+    }
+#endif
+    return ssl;
+  }
+
+  // Set up a connection to host:port before its handshake: SNI and a cached
+  // session if there is one. sessionKey has to outlive the SSL object, new
+  // session tickets are filed under it.
+  void prepare(SSL *ssl, const std::string &host,
+               const std::string &sessionKey) {
+    SSL_set_tlsext_host_name(ssl, host.c_str());
+    SSL_set_app_data(ssl, const_cast<std::string *>(&sessionKey));
+
+    std::lock_guard<std::mutex> lock(_sessionMutex);
+    if (auto it = _sessions.find(sessionKey); it != _sessions.end()) {
+      SSL_set_session(ssl, it->second);
+    }
+  }
+
+  // count the finished handshake as resumed or full, and with kernel TLS
+  // which directions the kernel took over
+  void handshakeDone(SSL *ssl) {
+    if (SSL_session_reused(ssl)) {
+      _resumedHandshakes.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      _fullHandshakes.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!_isKernelTls) {
+      return;
+    }
+    bool isSendOffloaded = BIO_get_ktls_send(SSL_get_wbio(ssl));
+    bool isReceiveOffloaded = BIO_get_ktls_recv(SSL_get_rbio(ssl));
+    if (isSendOffloaded) {
+      _kernelTlsSends.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (isReceiveOffloaded) {
+      _kernelTlsReceives.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!isSendOffloaded && !isReceiveOffloaded) {
+      _kernelTlsFallbacks.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  TlsContext()
+      : _fullHandshakes(metrics::Metrics::getInstance().counter(
+            "qabot_tls_full_handshakes_total")),
+        _resumedHandshakes(metrics::Metrics::getInstance().counter(
+            "qabot_tls_resumed_handshakes_total")),
+        _kernelTlsSends(metrics::Metrics::getInstance().counter(
+            "qabot_tls_ktls_send_sessions_total")),
+        _kernelTlsReceives(metrics::Metrics::getInstance().counter(
+            "qabot_tls_ktls_receive_sessions_total")),
+        _kernelTlsFallbacks(metrics::Metrics::getInstance().counter(
+            "qabot_tls_ktls_fallback_sessions_total")) {
+    // Initialize OpenSSL
+    OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS |
+                         OPENSSL_INIT_LOAD_CRYPTO_STRINGS,
+                     nullptr);
+    _sslContext = SSL_CTX_new(TLS_client_method());
+    if (!_sslContext) {
+      throw std::runtime_error("Failed to create SSL context");
+    }
+    SSL_CTX_set_min_proto_version(_sslContext, TLS1_2_VERSION);
+    // SSL_write returns once a record is out instead of insisting on the
+    // whole buffer, the write queue keeps track of the rest and may have
+    // moved it in the meantime
+    SSL_CTX_set_mode(_sslContext, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                                      SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    // OpenSSL's own cache only works for servers, clients get the sessions
+    // handed to _onNewSession and keep them themselves
+    SSL_CTX_set_session_cache_mode(_sslContext,
+                                   SSL_SESS_CACHE_CLIENT |
+                                       SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(_sslContext, &TlsContext::_onNewSession);
+  }
+
+  ~TlsContext() {
+    for (auto &[key, session] : _sessions) {
+      SSL_SESSION_free(session);
+    }
+    SSL_CTX_free(_sslContext);
+  }
+
+  // called by OpenSSL whenever the server issues a session, for TLS 1.3
+  // that happens after the handshake when the tickets arrive
+  static int _onNewSession(SSL *ssl, SSL_SESSION *session) {
+    auto sessionKey = static_cast<const std::string *>(SSL_get_app_data(ssl));
+    if (!sessionKey) {
+      return 0;
+    }
+
+    auto &instance = getInstance();
+    std::lock_guard<std::mutex> lock(instance._sessionMutex);
+    auto &cached = instance._sessions[*sessionKey];
+    if (cached) {
+      SSL_SESSION_free(cached);
+    }
+    // returning 1 keeps the reference OpenSSL handed us
+    cached = session;
+    return 1;
+  }
+
+  static inline bool _isKernelTls = false;
+
+  SSL_CTX *_sslContext = nullptr;
+
+  // newest session per host:port
+  std::unordered_map<std::string, SSL_SESSION *> _sessions;
+  std::mutex _sessionMutex;
+
+  std::atomic_int64_t &_fullHandshakes;
+  std::atomic_int64_t &_resumedHandshakes;
+  // kernel TLS sessions per offloaded direction, and those left in userspace
+  std::atomic_int64_t &_kernelTlsSends;
+  std::atomic_int64_t &_kernelTlsReceives;
+  std::atomic_int64_t &_kernelTlsFallbacks;
+};
+} // namespace qabot::socket
@@ -6,12 +6,20 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
 #include <iostream>
+#include <span>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "endpoint.hpp"
+#include "io_error.hpp"
 #include "socket.hpp"
 
 namespace qabot::socket {
@@ -31,9 +39,17 @@ class UnixSocketImpl {
 
   UnixSocketImpl& operator=(UnixSocketImpl&& other);
 
-  void connect(const std::string& serverName, const int port);
+  IoResult<void> connect(const std::string& serverName, const int port);
 
-  void send(const std::string& message);
+  // connect to an address that was already resolved
+  IoResult<void> connect(const Endpoint& endpoint);
+
+  // returns how many bytes the kernel took, the rest has to be sent again
+  IoResult<size_t> send(const std::string& message);
+
+  // gather write of several buffers in one system call, returns how many
+  // bytes the kernel took
+  IoResult<size_t> sendv(std::span<const std::string_view> buffers);
 
   void sendTo(const std::string& serverName, const int port,
               const std::string& message);
@@ -42,14 +58,24 @@ class UnixSocketImpl {
 
   std::pair<std::string, ClientInfo> receiveFrom(size_t bufferSize);
 
-  std::string receive(size_t bufferSize);
+  IoResult<std::string> receive(size_t bufferSize);
+
+  IoResult<size_t> receiveSome(char* data, size_t size);
 
-  UnixSocketImpl accept();
+  IoResult<UnixSocketImpl> accept();
 
   void listen(int backlog);
 
+  // Let other sockets that set SO_REUSEPORT bind the same port, the kernel
+  // spreads incoming connections across their listen queues. Must be called
+  // before bind.
+  bool setReusePort();
+
   void close();
 
+  // give up the handle without closing it, the caller closes it later
+  int release() { return std::exchange(_socket, -1); }
+
   bool init();
 
   int getSocketFD() const { return _socket; }
@@ -0,0 +1,111 @@
+#pragma once
+#ifdef QABOT_IO_URING
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "socket.hpp"
+#include "unix_socket_impl.hpp"
+
+namespace qabot::socket {
+// Linux socket whose data path runs through io_uring. Setting up a socket
+// (bind, listen, connect) is done with the plain syscalls of
+// UnixSocketImpl, the rest is handed to the kernel once and keeps going:
+//
+// - accept arms a multishot accept, connections queue up until taken
+// - receiveSome arms a multishot receive into the shared provided buffers,
+//   data queues up until read
+// - send copies into a staging buffer that is sent by one operation at a
+//   time, each linked to a timeout so a peer that stopped reading can't
+//   hold the socket forever
+//
+// The calls keep the non-blocking contract of the other implementations:
+// when nothing is queued they return the would-block IoErrc, and the
+// completion wakes the waiting coroutine through Reactor::notify.
+//
+// Nothing is armed on a socket before one of these calls. Without a usable
+// io_uring every call falls back to UnixSocketImpl.
+class UringSocketImpl {
+ public:
+  UringSocketImpl(TransportProtocol protocol, IPVersion ipVersion)
+      : _socket(protocol, ipVersion) {}
+
+  ~UringSocketImpl() { close(); }
+
+  UringSocketImpl(const UringSocketImpl& other) = delete;
+  UringSocketImpl& operator=(const UringSocketImpl& other) = delete;
+
+  UringSocketImpl(UringSocketImpl&& other) noexcept
+      : _socket(std::move(other._socket)),
+        _state(std::exchange(other._state, nullptr)) {}
+
+  UringSocketImpl& operator=(UringSocketImpl&& other) {
+    if (this != &other) {
+      close();
+      _socket = std::move(other._socket);
+      _state = std::exchange(other._state, nullptr);
+    }
+    return *this;
+  }
+
+  IoResult<void> connect(const std::string& serverName, const int port) {
+    return _socket.connect(serverName, port);
+  }
+  IoResult<void> connect(const Endpoint& endpoint) {
+    return _socket.connect(endpoint);
+  }
+
+  IoResult<size_t> send(const std::string& message);
+  IoResult<size_t> sendv(std::span<const std::string_view> buffers);
+
+  void sendTo(const std::string& serverName, const int port,
+              const std::string& message) {
+    _socket.sendTo(serverName, port, message);
+  }
+
+  void bind(const std::string& serverName, const int port) {
+    _socket.bind(serverName, port);
+  }
+
+  std::pair<std::string, ClientInfo> receiveFrom(size_t bufferSize) {
+    return _socket.receiveFrom(bufferSize);
+  }
+
+  IoResult<std::string> receive(size_t bufferSize);
+
+  IoResult<size_t> receiveSome(char* data, size_t size);
+
+  IoResult<UringSocketImpl> accept();
+
+  void listen(int backlog) { _socket.listen(backlog); }
+
+  bool setReusePort() { return _socket.setReusePort(); }
+
+  // the handle is closed once the last operation on it completed, staged
+  // data is still sent
+  void close();
+
+  bool init() { return _socket.init(); }
+
+  int getSocketFD() const { return _socket.getSocketFD(); }
+
+  TransportProtocol getProtocol() const { return _socket.getProtocol(); }
+  IPVersion getIPVersion() const { return _socket.getIPVersion(); }
+
+ private:
+  // everything the completion thread touches, it outlives the socket until
+  // the last operation completed
+  struct State;
+
+  explicit UringSocketImpl(UnixSocketImpl&& socket)
+      : _socket(std::move(socket)) {}
+
+  // the state of this socket, nullptr if io_uring can't be used
+  State* _uring();
+
+  UnixSocketImpl _socket;
+  State* _state = nullptr;
+};
+}  // namespace qabot::socket
+#endif  // QABOT_IO_URING
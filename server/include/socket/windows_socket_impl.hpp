@@ -6,9 +6,14 @@
 #include <ws2ipdef.h>
 #include <ws2tcpip.h>
 
+#include <algorithm>
 #include <iostream>
+#include <span>
+#include <string_view>
 #include <vector>
 
+#include "endpoint.hpp"
+#include "io_error.hpp"
 #include "socket.hpp"
 
 namespace qabot::socket {
@@ -45,22 +50,34 @@ public:
     return *this;
   }
 
-  void connect(const std::string &serverName, const int port);
+  IoResult<void> connect(const std::string &serverName, const int port);
 
-  void send(const std::string &message);
+  // connect to an address that was already resolved
+  IoResult<void> connect(const Endpoint &endpoint);
+
+  // returns how many bytes the kernel took, the rest has to be sent again
+  IoResult<size_t> send(const std::string &message);
+
+  // gather write of several buffers in one system call, returns how many
+  // bytes the kernel took
+  IoResult<size_t> sendv(std::span<const std::string_view> buffers);
 
   void sendTo(const std::string &serverName, const int port,
               const std::string &message);
 
   void bind(const std::string &serverName, const int port);
 
-  std::string receive(size_t bufferSize);
+  IoResult<std::string> receive(size_t bufferSize);
+
+  IoResult<size_t> receiveSome(char *data, size_t size);
 
   std::pair<std::string, ClientInfo> receiveFrom(size_t bufferSize);
 
-  WindowsSocketImpl accept();
+  IoResult<WindowsSocketImpl> accept();
 
   void listen(int backlog);
+  // Windows has no load balancing SO_REUSEPORT
+  bool setReusePort() { return false; }
   void close();
 
   TransportProtocol getProtocol() const { return _protocol; }
@@ -5,6 +5,8 @@
 #include <iostream>
 #include <optional>
 
+#include "metrics/metrics.hpp"
+
 namespace qabot::task {
 
 template <typename T>
@@ -185,4 +187,45 @@ class Task<void> {
  private:
   std::coroutine_handle<promise_type> _handle;
 };
-}  // namespace qabot::task
\ No newline at end of file
+
+// A coroutine nobody waits for, like a client session. It starts right away
+// and its frame is freed the moment it finishes, so there is nothing to keep
+// or clean up afterwards. The number of running ones is exported as the
+// qabot_live_tasks gauge.
+class DetachedTask {
+ public:
+  class promise_type {
+   public:
+    promise_type() { _liveTasks().fetch_add(1, std::memory_order_relaxed); }
+    ~promise_type() { _liveTasks().fetch_sub(1, std::memory_order_relaxed); }
+
+    DetachedTask get_return_object() { return {}; }
+
+    std::suspend_never initial_suspend() { return {}; }
+
+    // not suspending at the end destroys the frame
+    std::suspend_never final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() {
+      // there is nobody to hand it to
+      try {
+        throw;
+      } catch (const std::exception& e) {
+        std::cerr << "Unhandled exception in detached task: " << e.what()
+                  << std::endl;
+      } catch (...) {
+        std::cerr << "Unhandled exception in detached task" << std::endl;
+      }
+    }
+
+    void return_void() {}
+
+   private:
+    static std::atomic_int64_t& _liveTasks() {
+      static auto& liveTasks =
+          metrics::Metrics::getInstance().counter("qabot_live_tasks");
+      return liveTasks;
+    }
+  };
+};
+}  // namespace qabot::task
@@ -0,0 +1,215 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace qabot::timer_wheel {
+using Clock = std::chrono::steady_clock;
+
+class TimerWheel;
+
+// A timer as seen by the wheel, embedded in whatever the owner wants to be
+// woken up with. The wheel only links it into a slot, so arming doesn't
+// allocate. It must be cancelled before it is destroyed.
+class Timer {
+public:
+  Timer() = default;
+
+  Timer(const Timer &) = delete;
+  Timer &operator=(const Timer &) = delete;
+
+  bool isArmed() const { return _next != nullptr; }
+
+private:
+  friend class TimerWheel;
+
+  Timer *_prev = nullptr;
+  Timer *_next = nullptr;
+  // tick the timer fires at
+  uint64_t _expiry = 0;
+  uint8_t _level = 0;
+  uint8_t _slot = 0;
+};
+
+// Hierarchical timer wheel with millisecond ticks. Level 0 has one slot per
+// tick for the next 64 ms, every level above covers 64 times the span of
+// the one below with slots as wide as the whole level below. A timer is
+// put into the finest level its distance fits in and moves down a level
+// whenever the slot it waits in comes up, so arming and cancelling are O(1)
+// and a tick only touches the timers that are due or move down.
+//
+// Timers further away than the top level reaches wait in its last slot and
+// are placed again from there. Timers never fire early: deadlines are
+// rounded up to the next tick.
+//
+// Not thread safe, the owner serializes access.
+class TimerWheel {
+public:
+  static constexpr size_t kLevels = 4;
+  static constexpr size_t kSlotBits = 6;
+  static constexpr size_t kSlots = size_t{1} << kSlotBits;
+  using Tick = std::chrono::milliseconds;
+
+  TimerWheel() : _start(Clock::now()) {
+    for (auto &level : _slots) {
+      for (auto &slot : level) {
+        slot._prev = slot._next = &slot;
+      }
+    }
+  }
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  // (re)arm timer to fire once deadline passed
+  void arm(Timer &timer, Clock::time_point deadline) {
+    cancel(timer);
+    auto sinceStart = std::chrono::ceil<Tick>(deadline - _start).count();
+    // a deadline in the past fires with the next advance
+    timer._expiry = std::max<uint64_t>(std::max<int64_t>(sinceStart, 0),
+                                       _now + 1);
+    _insert(timer);
+    ++_count;
+  }
+
+  void cancel(Timer &timer) {
+    if (!timer.isArmed()) {
+      return;
+    }
+    _unlink(timer);
+    --_count;
+  }
+
+  size_t size() const { return _count; }
+
+  // Fire everything due at now, onExpired(Timer &) is called with each timer
+  // after it was disarmed, so it may arm it again
+  template <typename OnExpired>
+  void advance(Clock::time_point now, OnExpired &&onExpired) {
+    auto target = std::chrono::floor<Tick>(now - _start).count();
+    while (_now < static_cast<uint64_t>(target)) {
+      if (_count == 0) {
+        _now = target;
+        break;
+      }
+      // jump over the ticks where nothing happens
+      _now = std::min(_nextEvent(), static_cast<uint64_t>(target));
+      _cascade();
+
+      auto &due = _slots[0][_now & (kSlots - 1)];
+      while (due._next != &due) {
+        auto &timer = *due._next;
+        _unlink(timer);
+        --_count;
+        onExpired(timer);
+      }
+    }
+  }
+
+  // when advance has to be called next, nothing when no timer is armed. It
+  // can be earlier than the first expiry, when a timer has to move down a
+  // level first.
+  std::optional<Clock::time_point> nextWakeUp() const {
+    if (_count == 0) {
+      return std::nullopt;
+    }
+    return _start + Tick(_nextEvent());
+  }
+
+private:
+  // the first tick after _now that fires timers or moves them down
+  uint64_t _nextEvent() const {
+    uint64_t next = UINT64_MAX;
+    for (size_t level = 0; level < kLevels; ++level) {
+      if (_occupied[level] == 0) {
+        continue;
+      }
+      auto shift = level * kSlotBits;
+      // the slots after the current one first, the current one itself only
+      // comes up again after a full turn
+      auto current = (_now >> shift) & (kSlots - 1);
+      auto rotated = std::rotr(_occupied[level], current + 1);
+      auto distance = std::countr_zero(rotated) + 1;
+      // the slot comes up when the levels below wrapped around to it
+      auto tick = ((_now >> shift) + distance) << shift;
+      next = std::min<uint64_t>(next, tick);
+    }
+    return next;
+  }
+
+  // move the timers of the slots that came up at _now down a level, from
+  // the bottom up: a level is only looked at when the one below wrapped
+  void _cascade() {
+    for (size_t level = 1; level < kLevels; ++level) {
+      auto shift = level * kSlotBits;
+      if ((_now & ((uint64_t{1} << shift) - 1)) != 0) {
+        break;
+      }
+      auto index = (_now >> shift) & (kSlots - 1);
+      auto &slot = _slots[level][index];
+      if (slot._next == &slot) {
+        continue;
+      }
+      // detach the list first, timers may land in this slot again
+      auto *timer = slot._next;
+      slot._prev->_next = nullptr;
+      slot._next = slot._prev = &slot;
+      _occupied[level] &= ~(uint64_t{1} << index);
+      while (timer) {
+        auto *next = timer->_next;
+        _insert(*timer);
+        timer = next;
+      }
+    }
+  }
+
+  void _insert(Timer &timer) {
+    auto distance = timer._expiry - _now;
+    size_t level = 0;
+    while (level + 1 < kLevels &&
+           distance >= (uint64_t{1} << ((level + 1) * kSlotBits))) {
+      ++level;
+    }
+    auto shift = level * kSlotBits;
+    auto expiry = timer._expiry;
+    if (distance >= (uint64_t{1} << ((level + 1) * kSlotBits))) {
+      // beyond the top level, wait in its farthest slot and be placed again
+      // from there
+      expiry = _now + (uint64_t{1} << ((level + 1) * kSlotBits)) - 1;
+    }
+    auto index = (expiry >> shift) & (kSlots - 1);
+
+    auto &slot = _slots[level][index];
+    timer._level = static_cast<uint8_t>(level);
+    timer._slot = static_cast<uint8_t>(index);
+    timer._prev = slot._prev;
+    timer._next = &slot;
+    slot._prev->_next = &timer;
+    slot._prev = &timer;
+    _occupied[level] |= uint64_t{1} << index;
+  }
+
+  void _unlink(Timer &timer) {
+    timer._prev->_next = timer._next;
+    timer._next->_prev = timer._prev;
+    auto &slot = _slots[timer._level][timer._slot];
+    if (slot._next == &slot) {
+      _occupied[timer._level] &= ~(uint64_t{1} << timer._slot);
+    }
+    timer._prev = timer._next = nullptr;
+  }
+
+  Clock::time_point _start;
+  // last tick that was processed, counted from _start
+  uint64_t _now = 0;
+  size_t _count = 0;
+  // list heads, each slot is a circular list through its sentinel
+  std::array<std::array<Timer, kSlots>, kLevels> _slots;
+  // one bit per non-empty slot, to find the next one without scanning
+  std::array<uint64_t, kLevels> _occupied{};
+};
+} // namespace qabot::timer_wheel
@@ -0,0 +1,122 @@
+#pragma once
+#ifdef QABOT_IO_URING
+#include <linux/io_uring.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace qabot::uring {
+// An operation in flight, its address is the user data of the submission.
+// onComplete runs on the completion thread once per completion, multishot
+// operations get several until one comes without IORING_CQE_F_MORE.
+struct Operation {
+  void (*onComplete)(void *context, int result, uint32_t flags) = nullptr;
+  void *context = nullptr;
+};
+
+// The process wide io_uring. Workers submit under a lock, a dedicated thread
+// waits for completions and hands them to their operations, which wake the
+// waiting coroutines through the reactor.
+//
+// Receives use provided buffers (group kBufferGroup) that the kernel picks
+// from when data arrives, so a multishot receive doesn't need a buffer per
+// socket. The socket keeps the buffer until its reader copied the data
+// straight into its own buffer and recycled it, the recycled ones go back to
+// the kernel after each batch of completions. A receive that found no buffer
+// ends with ENOBUFS, which is a completion too.
+//
+// If the kernel doesn't support what we need (or io_uring is disabled), the
+// ring stays unavailable and callers use the plain non-blocking syscalls.
+class Uring {
+public:
+  static constexpr unsigned kEntries = 1024;
+  static constexpr unsigned kBufferCount = 1024;
+  static constexpr size_t kBufferSize = 16 * 1024;
+  static constexpr uint16_t kBufferGroup = 0;
+
+  // singleton
+  static Uring &getInstance() {
+    static Uring instance;
+    return instance;
+  }
+
+  Uring(const Uring &) = delete;
+  Uring &operator=(const Uring &) = delete;
+  Uring(Uring &&) = delete;
+  Uring &operator=(Uring &&) = delete;
+
+  // must be called before the first use
+  static void setEnabled(bool isEnabled) { _isEnabled = isEnabled; }
+
+  bool isAvailable() const { return _ringFd >= 0; }
+
+  // Queue the entries in order and submit them with a single system call,
+  // so entries linked with IOSQE_IO_LINK stay together
+  void submit(std::initializer_list<io_uring_sqe> entries) {
+    _submit(entries.begin(), entries.size());
+  }
+
+  // contents of a provided buffer the kernel filled
+  std::string_view buffer(uint16_t id, size_t size) const {
+    return {_buffers + size_t{id} * kBufferSize, size};
+  }
+
+  // hand a provided buffer back to the kernel, from any thread
+  void recycle(uint16_t id) {
+    std::lock_guard<std::mutex> lock(_recycleMutex);
+    _recycled.push_back(id);
+  }
+
+private:
+  Uring();
+  ~Uring();
+
+  void _setUp();
+  void _setUpBuffers();
+  void _tearDown();
+  void _submit(const io_uring_sqe *entries, size_t count);
+  void _provideRecycled();
+  void _completionLoop();
+
+  static inline bool _isEnabled = true;
+
+  int _ringFd = -1;
+
+  // submission queue
+  void *_sqRing = nullptr;
+  size_t _sqRingSize = 0;
+  unsigned *_sqHead = nullptr;
+  unsigned *_sqTail = nullptr;
+  unsigned _sqMask = 0;
+  unsigned *_sqArray = nullptr;
+  io_uring_sqe *_sqes = nullptr;
+  size_t _sqesSize = 0;
+  std::mutex _submitMutex;
+
+  // completion queue, shares the mapping with the submission queue when
+  // the kernel supports it
+  void *_cqRing = nullptr;
+  size_t _cqRingSize = 0;
+  unsigned *_cqHead = nullptr;
+  unsigned *_cqTail = nullptr;
+  unsigned _cqMask = 0;
+  io_uring_cqe *_cqes = nullptr;
+
+  // provided buffers, and the ones to give back after this batch
+  char *_buffers = nullptr;
+  std::vector<uint16_t> _recycled;
+  std::mutex _recycleMutex;
+  // the recycled ones taken by the completion thread
+  std::vector<uint16_t> _providing;
+
+  std::thread _completionThread;
+  std::atomic_bool _isRunning{true};
+};
+} // namespace qabot::uring
+#endif // QABOT_IO_URING
@@ -0,0 +1,131 @@
+#pragma once
+#include <algorithm>
+#include <deque>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "awaitable/awaitable.hpp"
+#include "socket/io_error.hpp"
+
+namespace qabot::write_queue {
+// Outbound side of one connection. A write first goes straight to the
+// socket, only the part the kernel doesn't take is copied into the queue,
+// which drains whenever the socket becomes writable again. Nothing is ever
+// dropped on a short write.
+//
+// asyncWrite() only suspends while more than the high water mark is queued,
+// so a producer (the upstream reads of the relay) is throttled to the pace
+// of a slow reader instead of buffering without bound.
+//
+// Stream needs sendv(std::span<const std::string_view>) returning a
+// socket::IoResult with the number of bytes taken, and getSocketFD().
+template <typename Stream> class WriteQueue {
+public:
+  static constexpr size_t kDefaultHighWaterMark = 256 * 1024;
+
+  explicit WriteQueue(Stream &stream,
+                      size_t highWaterMark = kDefaultHighWaterMark)
+      : _stream(stream), _highWaterMark(highWaterMark) {}
+
+  WriteQueue(const WriteQueue &) = delete;
+  WriteQueue &operator=(const WriteQueue &) = delete;
+
+  // Queue the buffers and wait until at most the high water mark is left.
+  // The buffers only need to live until the awaitable is first resumed,
+  // whatever is still needed afterwards has been copied.
+  auto asyncWrite(std::span<const std::string_view> buffers) {
+    return _write(buffers, _highWaterMark);
+  }
+
+  // queue the buffers and wait until everything queued has been written
+  auto asyncWriteAll(std::span<const std::string_view> buffers) {
+    return _write(buffers, 0);
+  }
+
+  auto asyncWriteAll(std::string_view data) {
+    // the span would dangle, keep the view inside the operation
+    return awaitable::Awaitable(
+        _stream.getSocketFD(), [this, data, isQueued = false]() mutable {
+          if (!isQueued) {
+            isQueued = true;
+            _writeOrQueue(std::span<const std::string_view>(&data, 1));
+          }
+          return _drain(0);
+        });
+  }
+
+  // bytes accepted by asyncWrite but not written to the socket yet
+  size_t pending() const { return _pendingSize; }
+
+private:
+  auto _write(std::span<const std::string_view> buffers, size_t limit) {
+    return awaitable::Awaitable(
+        _stream.getSocketFD(),
+        [this, buffers, limit, isQueued = false]() mutable {
+          // retries only drain, the buffers were taken on the first try
+          if (!isQueued) {
+            isQueued = true;
+            _writeOrQueue(buffers);
+          }
+          return _drain(limit);
+        });
+  }
+
+  void _writeOrQueue(std::span<const std::string_view> buffers) {
+    size_t written = 0;
+    if (_queue.empty()) {
+      // nothing ahead of us, try without copying
+      written = _stream.sendv(buffers).value_or(0);
+    }
+
+    for (auto buffer : buffers) {
+      if (written >= buffer.size()) {
+        written -= buffer.size();
+        continue;
+      }
+      buffer.remove_prefix(written);
+      written = 0;
+      _queue.emplace_back(buffer);
+      _pendingSize += buffer.size();
+    }
+  }
+
+  // write queued bytes until at most limit are left, returns the stream's
+  // would-block status when the socket is full before that
+  socket::IoResult<void> _drain(size_t limit) {
+    constexpr size_t kMaxBuffers = 16;
+    while (_pendingSize > limit) {
+      std::string_view buffers[kMaxBuffers];
+      size_t count = std::min(_queue.size(), kMaxBuffers);
+      for (size_t i = 0; i < count; ++i) {
+        buffers[i] = _queue[i];
+      }
+      buffers[0].remove_prefix(_frontOffset);
+
+      auto sent = _stream.sendv(std::span(buffers, count));
+      if (!sent) {
+        return std::unexpected(sent.error());
+      }
+      auto written = *sent;
+      _pendingSize -= written;
+      written += _frontOffset;
+      while (!_queue.empty() && written >= _queue.front().size()) {
+        written -= _queue.front().size();
+        _queue.pop_front();
+      }
+      _frontOffset = written;
+    }
+    return {};
+  }
+
+  Stream &_stream;
+  size_t _highWaterMark;
+
+  std::deque<std::string> _queue;
+  // bytes of the front buffer that were already written
+  size_t _frontOffset = 0;
+  size_t _pendingSize = 0;
+};
+} // namespace qabot::write_queue
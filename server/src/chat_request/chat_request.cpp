@@ -0,0 +1,91 @@
+#include "chat_request/chat_request.hpp"
+
+#include <stdexcept>
+
+#include "json_reader/json_reader.hpp"
+#include "json_writer/json_writer.hpp"
+
+namespace qabot::chat_request {
+namespace {
+void writeContent(json_writer::JsonWriter &writer, std::string_view role,
+                  std::string_view text) {
+  writer.beginObject()
+      .key("role")
+      .escapedString(role)
+      .key("parts")
+      .beginArray()
+      .beginObject()
+      .key("text")
+      .escapedString(text)
+      .endObject()
+      .endArray()
+      .endObject();
+}
+} // namespace
+
+ChatRequest parseChatRequest(std::string_view body,
+                             std::pmr::polymorphic_allocator<> allocator) {
+  using json_reader::JsonReader;
+
+  ChatRequest chat(allocator);
+  bool hasModelName = false;
+  bool hasPrompt = false;
+  bool hasMessage = false;
+
+  JsonReader reader(body);
+  reader.beginObject();
+  while (auto key = reader.nextKey()) {
+    if (*key == "model_name") {
+      chat.modelName = reader.string();
+      hasModelName = true;
+    } else if (*key == "prompt") {
+      chat.prompt = reader.string();
+      hasPrompt = true;
+    } else if (*key == "message") {
+      chat.message = reader.string();
+      hasMessage = true;
+    } else if (*key == "context" &&
+               reader.peek() == JsonReader::Type::Array) {
+      // [{"user": "..."}, {"model": "..."}, ...]
+      reader.beginArray();
+      while (reader.nextElement()) {
+        reader.beginObject();
+        while (auto role = reader.nextKey()) {
+          chat.context.emplace_back(*role, reader.string());
+        }
+      }
+    } else {
+      reader.skip();
+    }
+  }
+  reader.end();
+
+  if (!hasModelName || !hasPrompt || !hasMessage) {
+    throw std::runtime_error("model_name, prompt and message are required");
+  }
+  return chat;
+}
+
+void writeUpstreamBody(std::pmr::string &output, const ChatRequest &chat) {
+  json_writer::JsonWriter writer(output);
+  writer.beginObject()
+      .key("system_instruction")
+      .beginObject()
+      .key("parts")
+      .beginArray()
+      .beginObject()
+      .key("text")
+      .escapedString(chat.prompt)
+      .endObject()
+      .endArray()
+      .endObject()
+      .key("contents")
+      .beginArray();
+  for (auto [role, text] : chat.context) {
+    writeContent(writer, role, text);
+  }
+  // the last message from user
+  writeContent(writer, "user", chat.message);
+  writer.endArray().endObject();
+}
+} // namespace qabot::chat_request
@@ -0,0 +1,134 @@
+#include "dns_resolver/dns_resolver.hpp"
+
+#include <cstring>
+#include <system_error>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#endif
+
+namespace qabot::dns_resolver {
+DnsResolver::DnsResolver() {
+  _resolverThread = std::thread([this] { _resolverLoop(); });
+}
+
+DnsResolver::~DnsResolver() {
+  {
+    std::lock_guard<std::mutex> lock(_pendingMutex);
+    _isRunning = false;
+  }
+  _pendingCondition.notify_all();
+  if (_resolverThread.joinable()) {
+    _resolverThread.join();
+  }
+}
+
+void DnsResolver::_enqueue(Lookup *lookup) {
+  {
+    std::lock_guard<std::mutex> lock(_pendingMutex);
+    _pendingLookups.push_back(lookup);
+  }
+  _pendingCondition.notify_one();
+}
+
+void DnsResolver::_resolverLoop() {
+  while (true) {
+    Lookup *lookup = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(_pendingMutex);
+      _pendingCondition.wait(
+          lock, [this] { return !_isRunning || !_pendingLookups.empty(); });
+      if (!_isRunning) {
+        return;
+      }
+      lookup = _pendingLookups.front();
+      _pendingLookups.pop_front();
+    }
+
+    // a lookup queued earlier for the same name may have filled the cache
+    if (auto cached = _fromCache(*lookup); cached) {
+      lookup->endpoints = std::move(*cached);
+    } else {
+      try {
+        auto endpoints = _lookupNow(*lookup);
+        {
+          std::lock_guard<std::mutex> lock(_cacheMutex);
+          _cache[_key(*lookup)] = CacheEntry{
+              endpoints, std::chrono::steady_clock::now() + kCacheTtl, 1};
+        }
+        lookup->endpoints = std::move(endpoints);
+      } catch (const std::exception &e) {
+        lookup->exceptionPtr = std::current_exception();
+      }
+    }
+
+    // resume the coroutine on the worker that asked
+    event_manager::EventManager::getInstance().addEvent(lookup->onDone,
+                                                        lookup->workerIndex);
+  }
+}
+
+std::optional<std::vector<socket::Endpoint>>
+DnsResolver::_fromCache(const Lookup &lookup) {
+  std::lock_guard<std::mutex> lock(_cacheMutex);
+  auto it = _cache.find(_key(lookup));
+  if (it == _cache.end()) {
+    return std::nullopt;
+  }
+  auto &entry = it->second;
+  if (std::chrono::steady_clock::now() >= entry.expiresAt) {
+    _cache.erase(it);
+    return std::nullopt;
+  }
+
+  std::vector<socket::Endpoint> endpoints;
+  endpoints.reserve(entry.endpoints.size());
+  for (size_t i = 0; i < entry.endpoints.size(); ++i) {
+    endpoints.push_back(
+        entry.endpoints[(entry.nextIndex + i) % entry.endpoints.size()]);
+  }
+  entry.nextIndex = (entry.nextIndex + 1) % entry.endpoints.size();
+  return endpoints;
+}
+
+std::vector<socket::Endpoint> DnsResolver::_lookupNow(const Lookup &lookup) {
+  auto endpoints = _lookupFunction(lookup.host, lookup.port, lookup.ipVersion);
+  if (endpoints.empty()) {
+    throw std::runtime_error("No addresses found for " + lookup.host);
+  }
+  return endpoints;
+}
+
+std::vector<socket::Endpoint>
+DnsResolver::_getAddrInfo(const std::string &host, int port,
+                          socket::IPVersion ipVersion) {
+  addrinfo hints{};
+  hints.ai_family = ipVersion == socket::IPVersion::IPv4 ? AF_INET : AF_INET6;
+  hints.ai_socktype = SOCK_STREAM;
+
+  addrinfo *addrInfo = nullptr;
+  auto result = getaddrinfo(host.c_str(), std::to_string(port).c_str(),
+                            &hints, &addrInfo);
+  if (result != 0) {
+    throw std::runtime_error("Failed to resolve " + host + ": " +
+                             gai_strerror(result));
+  }
+
+  std::vector<socket::Endpoint> endpoints;
+  for (addrinfo *p = addrInfo; p != nullptr; p = p->ai_next) {
+    socket::Endpoint endpoint;
+    std::memcpy(&endpoint.address, p->ai_addr, p->ai_addrlen);
+    endpoint.length = static_cast<socklen_t>(p->ai_addrlen);
+    endpoints.push_back(endpoint);
+  }
+  freeaddrinfo(addrInfo);
+  return endpoints;
+}
+
+std::string DnsResolver::_key(const Lookup &lookup) {
+  return lookup.host + ":" + std::to_string(lookup.port) +
+         (lookup.ipVersion == socket::IPVersion::IPv4 ? "/4" : "/6");
+}
+} // namespace qabot::dns_resolver
@@ -0,0 +1,57 @@
+#include "http/header_field.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+namespace qabot::http {
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+  return std::ranges::equal(a, b, [](char lhs, char rhs) {
+    return std::tolower(static_cast<unsigned char>(lhs)) ==
+           std::tolower(static_cast<unsigned char>(rhs));
+  });
+}
+
+std::string_view trim(std::string_view value) {
+  auto begin = value.find_first_not_of(" \t");
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  auto end = value.find_last_not_of(" \t");
+  return value.substr(begin, end - begin + 1);
+}
+
+bool hasToken(std::string_view value, std::string_view token) {
+  while (!value.empty()) {
+    auto comma = value.find(',');
+    if (equalsIgnoreCase(trim(value.substr(0, comma)), token)) {
+      return true;
+    }
+    if (comma == std::string_view::npos) {
+      break;
+    }
+    value.remove_prefix(comma + 1);
+  }
+  return false;
+}
+
+bool ResponseFraming::addHeader(std::string_view name, std::string_view value) {
+  value = trim(value);
+  if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+    isChunked = hasToken(value, "chunked");
+  } else if (equalsIgnoreCase(name, "Content-Length")) {
+    size_t length = 0;
+    auto [end, errc] =
+        std::from_chars(value.data(), value.data() + value.size(), length);
+    if (value.empty() || errc != std::errc{} ||
+        end != value.data() + value.size() ||
+        (contentLength && *contentLength != length)) {
+      return false;
+    }
+    contentLength = length;
+  } else if (equalsIgnoreCase(name, "Connection")) {
+    isClose = isClose || hasToken(value, "close");
+  }
+  return true;
+}
+} // namespace qabot::http
@@ -0,0 +1,122 @@
+#include "http/http_scan.hpp"
+
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||           \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QABOT_SCAN_SSE2 1
+#include <immintrin.h>
+#endif
+
+// AVX2 is only compiled in where the compiler can target it per function,
+// the binary itself still runs on plain SSE2 machines
+#if defined(QABOT_SCAN_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define QABOT_SCAN_AVX2 1
+#endif
+
+namespace qabot::http {
+namespace {
+// offset of the first a or b in [data, data + size), size if there is none
+using FindEitherFn = size_t (*)(const char *data, size_t size, char a, char b);
+
+size_t findEitherScalar(const char *data, size_t size, char a, char b) {
+  for (size_t i = 0; i < size; ++i) {
+    if (data[i] == a || data[i] == b) {
+      return i;
+    }
+  }
+  return size;
+}
+
+#ifdef QABOT_SCAN_SSE2
+size_t findEitherSse2(const char *data, size_t size, char a, char b) {
+  const __m128i needleA = _mm_set1_epi8(a);
+  const __m128i needleB = _mm_set1_epi8(b);
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(block, needleA),
+                                   _mm_cmpeq_epi8(block, needleB));
+    if (auto mask = static_cast<uint32_t>(_mm_movemask_epi8(matches)); mask) {
+      return i + std::countr_zero(mask);
+    }
+  }
+  return i + findEitherScalar(data + i, size - i, a, b);
+}
+#endif
+
+#ifdef QABOT_SCAN_AVX2
+__attribute__((target("avx2"))) size_t findEitherAvx2(const char *data,
+                                                      size_t size, char a,
+                                                      char b) {
+  const __m256i needleA = _mm256_set1_epi8(a);
+  const __m256i needleB = _mm256_set1_epi8(b);
+
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(block, needleA),
+                                      _mm256_cmpeq_epi8(block, needleB));
+    if (auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(matches));
+        mask) {
+      return i + std::countr_zero(mask);
+    }
+  }
+  // at most 31 bytes are left, one SSE2 step and the scalar tail. The SSE2
+  // code isn't VEX encoded, running it with the upper halves of the ymm
+  // registers dirty costs a state transition on every call.
+  _mm256_zeroupper();
+  return i + findEitherSse2(data + i, size - i, a, b);
+}
+#endif
+
+struct Scanner {
+  FindEitherFn findEither;
+  std::string_view name;
+};
+
+Scanner selectScanner() {
+#ifdef QABOT_SCAN_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return {&findEitherAvx2, "avx2"};
+  }
+#endif
+#ifdef QABOT_SCAN_SSE2
+  return {&findEitherSse2, "sse2"};
+#else
+  return {&findEitherScalar, "scalar"};
+#endif
+}
+
+const Scanner &scanner() {
+  static const Scanner instance = selectScanner();
+  return instance;
+}
+
+size_t findEither(std::string_view data, size_t from, char a, char b) {
+  if (from >= data.size()) {
+    return std::string_view::npos;
+  }
+  auto offset =
+      scanner().findEither(data.data() + from, data.size() - from, a, b);
+  return offset == data.size() - from ? std::string_view::npos
+                                      : from + offset;
+}
+} // namespace
+
+size_t findNewline(std::string_view data, size_t from) {
+  // memchr already has a vector loop per CPU, tuned beyond ours for one byte
+  return data.find('\n', from);
+}
+
+size_t findColonOrNewline(std::string_view data, size_t from) {
+  return findEither(data, from, ':', '\n');
+}
+
+std::string_view scanImplementation() { return scanner().name; }
+} // namespace qabot::http
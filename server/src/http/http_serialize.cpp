@@ -9,31 +9,36 @@ serializeRequest(const RequestMethod method, const std::string &url,
       headers.find("Content-Type") == headers.end()) {
     throw std::runtime_error("POST request must have Content-Type header");
   }
-  std::stringstream requestStream;
   std::string methodStr = requestMethodToString(method);
-  requestStream << methodStr << " " << url << " HTTP/1.1\r\n";
+  std::string request;
+  request.reserve(methodStr.size() + url.size() + 64 + body.size());
+  request.append(methodStr).append(" ").append(url).append(" HTTP/1.1\r\n");
   for (const auto &[key, value] : headers) {
-    requestStream << key << ": " << value << "\r\n";
+    request.append(key).append(": ").append(value).append("\r\n");
   }
   if (!body.empty()) {
-    requestStream << "Content-Length: " << body.size() << "\r\n";
-    requestStream << "\r\n" << body;
+    request.append("Content-Length: ")
+        .append(std::to_string(body.size()))
+        .append("\r\n\r\n")
+        .append(body);
   }
-  return requestStream.str();
+  return request;
 }
 std::string
 serializeResponse(const ResponseStatus statusCode,
                   const std::unordered_map<std::string, std::string> &headers,
                   const std::string &body) {
-  std::stringstream responseStream;
   std::string statusStr = responseStatusToString(statusCode);
-
-  responseStream << "HTTP/2 " << statusStr << "\r\n";
+  std::string response;
+  response.reserve(statusStr.size() + 64 + body.size());
+  response.append("HTTP/1.1 ").append(statusStr).append("\r\n");
   for (const auto &[key, value] : headers) {
-    responseStream << key << ": " << value << "\r\n";
+    response.append(key).append(": ").append(value).append("\r\n");
   }
-  responseStream << "Content-Length: " << body.size() << "\r\n";
-  responseStream << "\r\n" << body;
-  return responseStream.str();
+  response.append("Content-Length: ")
+      .append(std::to_string(body.size()))
+      .append("\r\n\r\n")
+      .append(body);
+  return response;
 }
 } // namespace qabot::http
\ No newline at end of file
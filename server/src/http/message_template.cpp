@@ -0,0 +1,52 @@
+#include "http/message_template.hpp"
+
+#include <charconv>
+#include <stdexcept>
+
+namespace qabot::http {
+namespace {
+constexpr std::string_view kContentLength = "Content-Length: ";
+constexpr std::string_view kHeadEnd = "\r\n\r\n";
+} // namespace
+
+MessageTemplate::MessageTemplate(
+    std::initializer_list<std::string_view> fragments) {
+  if (fragments.size() == 0) {
+    throw std::invalid_argument("A message template needs a start line");
+  }
+  for (auto fragment : fragments) {
+    _fragments.emplace_back(fragment);
+    _fixedSize += fragment.size();
+  }
+  // the framing is the same for every message
+  _fragments.back().append(kContentLength);
+  _fixedSize += kContentLength.size() + kHeadEnd.size();
+}
+
+void MessageTemplate::render(std::pmr::string &output,
+                             std::initializer_list<std::string_view> values,
+                             std::string_view body) const {
+  if (values.size() != holes()) {
+    throw std::invalid_argument("Wrong number of values for the template");
+  }
+
+  char contentLength[20];
+  auto contentLengthEnd =
+      std::to_chars(contentLength, contentLength + sizeof(contentLength),
+                    body.size())
+          .ptr;
+
+  size_t size = _fixedSize + (contentLengthEnd - contentLength) + body.size();
+  for (auto value : values) {
+    size += value.size();
+  }
+  output.reserve(output.size() + size);
+
+  auto fragment = _fragments.begin();
+  output.append(*fragment++);
+  for (auto value : values) {
+    output.append(value).append(*fragment++);
+  }
+  output.append(contentLength, contentLengthEnd).append(kHeadEnd).append(body);
+}
+} // namespace qabot::http
@@ -0,0 +1,269 @@
+#include "http/request_parser.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+#include "http/header_field.hpp"
+#include "http/http_scan.hpp"
+
+namespace qabot::http {
+std::optional<std::string_view>
+RequestHead::header(std::string_view name) const {
+  for (const auto &[key, value] : headers) {
+    if (equalsIgnoreCase(key, name)) {
+      return value;
+    }
+  }
+  return std::nullopt;
+}
+
+bool RequestHead::keepAlive() const {
+  // the header is a comma separated list of options
+  auto connection = header("Connection").value_or(std::string_view{});
+  if (version == "HTTP/1.0") {
+    return hasToken(connection, "keep-alive");
+  }
+  return !hasToken(connection, "close");
+}
+
+ParseStatus RequestParser::parse(std::string_view data) {
+  while (_state != State::Complete) {
+    switch (_state) {
+    case State::RequestLine: {
+      auto line = _nextLine(data);
+      if (!line) {
+        return ParseStatus::Incomplete;
+      }
+      // empty lines in front of a request are allowed
+      if (line->size > 0) {
+        _parseRequestLine(data, *line);
+        _state = State::Headers;
+      }
+      break;
+    }
+    case State::Headers: {
+      auto line = _nextLine(data);
+      if (!line) {
+        return ParseStatus::Incomplete;
+      }
+      if (line->size == 0) {
+        _finishHead(data);
+      } else {
+        _parseHeader(data, *line);
+      }
+      break;
+    }
+    case State::Body: {
+      if (data.size() - _offset < _remaining) {
+        return ParseStatus::Incomplete;
+      }
+      _bodySpans.push_back({_offset, _remaining});
+      _offset += _remaining;
+      _complete(data);
+      break;
+    }
+    case State::ChunkSize: {
+      auto line = _nextLine(data);
+      if (!line) {
+        return ParseStatus::Incomplete;
+      }
+      _parseChunkSize(data, *line);
+      break;
+    }
+    case State::ChunkData: {
+      // the chunk and the CRLF behind it
+      if (data.size() - _offset < 2 ||
+          _remaining > data.size() - _offset - 2) {
+        return ParseStatus::Incomplete;
+      }
+      if (data.substr(_offset + _remaining, 2) != "\r\n") {
+        throw std::runtime_error("Malformed chunk");
+      }
+      _bodySpans.push_back({_offset, _remaining});
+      _offset += _remaining + 2;
+      _scanned = _offset;
+      _state = State::ChunkSize;
+      break;
+    }
+    case State::Trailers: {
+      auto line = _nextLine(data);
+      if (!line) {
+        return ParseStatus::Incomplete;
+      }
+      // trailer fields are skipped, the empty line ends the request
+      if (line->size == 0) {
+        _complete(data);
+      }
+      break;
+    }
+    case State::Complete:
+      break;
+    }
+  }
+  return ParseStatus::Complete;
+}
+
+void RequestParser::reset() {
+  _state = State::RequestLine;
+  _offset = 0;
+  _scanned = 0;
+  _path = {};
+  _version = {};
+  _headerSpans.clear();
+  _bodySpans.clear();
+  _hasContentLength = false;
+  _isChunked = false;
+  _remaining = 0;
+  _chunkedSize = 0;
+  _head.method = RequestMethod::Get;
+  _head.path = {};
+  _head.version = {};
+  _head.headers.clear();
+  _bodyParts.clear();
+}
+
+size_t RequestParser::bodySize() const {
+  size_t size = 0;
+  for (const auto &part : _bodyParts) {
+    size += part.size();
+  }
+  return size;
+}
+
+std::optional<RequestParser::Span>
+RequestParser::_nextLine(std::string_view data) {
+  auto searchFrom = std::max(_scanned, _offset);
+  auto pos = findNewline(data, searchFrom);
+  if (pos == std::string_view::npos) {
+    _scanned = data.size();
+    bool isHead = _state == State::RequestLine || _state == State::Headers;
+    if ((isHead ? data.size() : data.size() - _offset) > kMaxHeadSize) {
+      throw std::runtime_error("HTTP request head too large");
+    }
+    return std::nullopt;
+  }
+
+  Span line{_offset, pos - _offset};
+  if (line.size > 0 && data[pos - 1] == '\r') {
+    --line.size;
+  }
+  _offset = pos + 1;
+  _scanned = _offset;
+  return line;
+}
+
+void RequestParser::_parseRequestLine(std::string_view data, Span line) {
+  auto text = line.in(data);
+  auto methodEnd = text.find(' ');
+  auto pathEnd = methodEnd == std::string_view::npos
+                     ? std::string_view::npos
+                     : text.find(' ', methodEnd + 1);
+  if (pathEnd == std::string_view::npos) {
+    throw std::runtime_error("Malformed HTTP request line");
+  }
+
+  auto method = stringToRequestMethod(text.substr(0, methodEnd));
+  if (!method) {
+    throw std::runtime_error("Unsupported HTTP method");
+  }
+  _head.method = *method;
+
+  _path = {line.offset + methodEnd + 1, pathEnd - methodEnd - 1};
+  _version = {line.offset + pathEnd + 1, line.size - pathEnd - 1};
+  if (!_version.in(data).starts_with("HTTP/1.")) {
+    throw std::runtime_error("Unsupported HTTP version");
+  }
+}
+
+void RequestParser::_parseHeader(std::string_view data, Span line) {
+  auto text = line.in(data);
+  auto colonPos = findColonOrNewline(text);
+  if (colonPos == std::string_view::npos || colonPos == 0) {
+    throw std::runtime_error("Malformed HTTP header");
+  }
+
+  auto value = trim(text.substr(colonPos + 1));
+  auto valueOffset =
+      value.empty() ? line.offset + line.size
+                    : line.offset + static_cast<size_t>(value.data() -
+                                                        text.data());
+  _headerSpans.emplace_back(Span{line.offset, colonPos},
+                            Span{valueOffset, value.size()});
+}
+
+void RequestParser::_finishHead(std::string_view data) {
+  for (const auto &[nameSpan, valueSpan] : _headerSpans) {
+    auto name = nameSpan.in(data);
+    auto value = valueSpan.in(data);
+    if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+      if (!equalsIgnoreCase(value, "chunked")) {
+        throw std::runtime_error("Unsupported Transfer-Encoding");
+      }
+      _isChunked = true;
+    } else if (equalsIgnoreCase(name, "Content-Length")) {
+      size_t contentLength = 0;
+      auto [end, errc] = std::from_chars(
+          value.data(), value.data() + value.size(), contentLength);
+      if (errc != std::errc{} || end != value.data() + value.size() ||
+          (_hasContentLength && contentLength != _remaining)) {
+        throw std::runtime_error("Invalid Content-Length");
+      }
+      if (contentLength > _maxBodySize) {
+        throw std::runtime_error("HTTP request body too large");
+      }
+      _hasContentLength = true;
+      _remaining = contentLength;
+    }
+  }
+
+  if (_isChunked) {
+    // chunked encoding wins over Content-Length
+    _remaining = 0;
+    _state = State::ChunkSize;
+  } else if (_remaining > 0) {
+    _state = State::Body;
+  } else {
+    _complete(data);
+  }
+}
+
+void RequestParser::_parseChunkSize(std::string_view data, Span line) {
+  auto text = line.in(data);
+  // chunk extensions are ignored
+  text = trim(text.substr(0, text.find(';')));
+
+  size_t chunkSize = 0;
+  auto [end, errc] =
+      std::from_chars(text.data(), text.data() + text.size(), chunkSize, 16);
+  if (text.empty() || errc != std::errc{} ||
+      end != text.data() + text.size()) {
+    throw std::runtime_error("Invalid chunk size");
+  }
+  if (chunkSize > _maxBodySize - _chunkedSize) {
+    throw std::runtime_error("HTTP request body too large");
+  }
+  _chunkedSize += chunkSize;
+
+  if (chunkSize == 0) {
+    _state = State::Trailers;
+  } else {
+    _remaining = chunkSize;
+    _state = State::ChunkData;
+  }
+}
+
+void RequestParser::_complete(std::string_view data) {
+  _head.path = _path.in(data);
+  _head.version = _version.in(data);
+  _head.headers.clear();
+  for (const auto &[name, value] : _headerSpans) {
+    _head.headers.emplace_back(name.in(data), value.in(data));
+  }
+  _bodyParts.clear();
+  for (const auto &span : _bodySpans) {
+    _bodyParts.push_back(span.in(data));
+  }
+  _state = State::Complete;
+}
+} // namespace qabot::http
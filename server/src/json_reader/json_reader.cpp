@@ -0,0 +1,339 @@
+#include "json_reader/json_reader.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+
+#include "json_writer/json_writer.hpp"
+
+namespace qabot::json_reader {
+namespace {
+bool isWhitespace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// value of a hex digit, -1 for anything else
+int hexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// the code unit of the four hex digits at data, -1 if they aren't
+int32_t hexCodeUnit(std::string_view data) {
+  if (data.size() < 4) {
+    return -1;
+  }
+  int32_t value = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    auto digit = hexValue(data[i]);
+    if (digit < 0) {
+      return -1;
+    }
+    value = value << 4 | digit;
+  }
+  return value;
+}
+
+void appendUtf8(std::pmr::string &output, uint32_t codePoint) {
+  if (codePoint < 0x80) {
+    output.push_back(static_cast<char>(codePoint));
+  } else if (codePoint < 0x800) {
+    output.push_back(static_cast<char>(0xc0 | codePoint >> 6));
+    output.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+  } else if (codePoint < 0x10000) {
+    output.push_back(static_cast<char>(0xe0 | codePoint >> 12));
+    output.push_back(static_cast<char>(0x80 | (codePoint >> 6 & 0x3f)));
+    output.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+  } else {
+    output.push_back(static_cast<char>(0xf0 | codePoint >> 18));
+    output.push_back(static_cast<char>(0x80 | (codePoint >> 12 & 0x3f)));
+    output.push_back(static_cast<char>(0x80 | (codePoint >> 6 & 0x3f)));
+    output.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+  }
+}
+} // namespace
+
+JsonReader::Type JsonReader::peek() {
+  _skipWhitespace();
+  if (_pos == _json.size()) {
+    _fail("unexpected end");
+  }
+  switch (_json[_pos]) {
+  case '{':
+    return Type::Object;
+  case '[':
+    return Type::Array;
+  case '"':
+    return Type::String;
+  case 't':
+  case 'f':
+    return Type::Bool;
+  case 'n':
+    return Type::Null;
+  default:
+    return Type::Number;
+  }
+}
+
+void JsonReader::beginObject() {
+  _expect('{');
+  _isFirst = true;
+}
+
+std::optional<std::string_view> JsonReader::nextKey() {
+  _skipWhitespace();
+  if (_pos < _json.size() && _json[_pos] == '}') {
+    ++_pos;
+    // the object itself was an element of its parent
+    _isFirst = false;
+    return std::nullopt;
+  }
+  if (!_isFirst) {
+    _expect(',');
+  }
+  _isFirst = false;
+
+  _skipWhitespace();
+  if (_pos == _json.size() || _json[_pos] != '"') {
+    _fail("expected a key");
+  }
+  auto key = _string();
+  _expect(':');
+  return key;
+}
+
+void JsonReader::beginArray() {
+  _expect('[');
+  _isFirst = true;
+}
+
+bool JsonReader::nextElement() {
+  _skipWhitespace();
+  if (_pos < _json.size() && _json[_pos] == ']') {
+    ++_pos;
+    _isFirst = false;
+    return false;
+  }
+  if (!_isFirst) {
+    _expect(',');
+  }
+  _isFirst = false;
+  return true;
+}
+
+std::string_view JsonReader::string() {
+  _skipWhitespace();
+  if (_pos == _json.size() || _json[_pos] != '"') {
+    _fail("expected a string");
+  }
+  return _string();
+}
+
+void JsonReader::skip() {
+  // one bit per open container, set for objects, to match the brackets
+  constexpr size_t kMaxDepth = 64;
+  uint64_t isObject = 0;
+  size_t depth = 0;
+  do {
+    _skipWhitespace();
+    if (_pos == _json.size()) {
+      _fail("unexpected end");
+    }
+    switch (char c = _json[_pos]) {
+    case '{':
+    case '[':
+      if (depth == kMaxDepth) {
+        _fail("nesting too deep");
+      }
+      isObject = isObject << 1 | (c == '{');
+      ++depth;
+      ++_pos;
+      break;
+    case '}':
+    case ']':
+      if (depth == 0 || (isObject & 1) != (c == '}')) {
+        _fail("mismatched bracket");
+      }
+      isObject >>= 1;
+      --depth;
+      ++_pos;
+      break;
+    case ',':
+    case ':':
+      // separators inside the skipped value, its structure isn't checked
+      // beyond matching brackets and valid strings
+      if (depth == 0) {
+        _fail("expected a value");
+      }
+      ++_pos;
+      break;
+    case '"':
+      _string();
+      break;
+    default:
+      _skipScalar();
+      break;
+    }
+  } while (depth > 0);
+}
+
+void JsonReader::end() {
+  _skipWhitespace();
+  if (_pos != _json.size()) {
+    _fail("unexpected trailing characters");
+  }
+}
+
+void JsonReader::_skipWhitespace() {
+  while (_pos < _json.size() && isWhitespace(_json[_pos])) {
+    ++_pos;
+  }
+}
+
+void JsonReader::_expect(char c) {
+  _skipWhitespace();
+  if (_pos == _json.size() || _json[_pos] != c) {
+    _fail(std::string("expected '") + c + "'");
+  }
+  ++_pos;
+}
+
+std::string_view JsonReader::_string() {
+  auto start = _pos + 1;
+  auto pos = start;
+  while (true) {
+    // jumps over plain text 16 or 32 bytes at a time
+    pos = json_writer::findEscape(_json, pos);
+    if (pos == std::string_view::npos) {
+      _fail("unterminated string");
+    }
+    if (_json[pos] == '"') {
+      _pos = pos + 1;
+      return _json.substr(start, pos - start);
+    }
+    if (_json[pos] != '\\') {
+      _pos = pos;
+      _fail("control character in string");
+    }
+
+    if (pos + 1 == _json.size()) {
+      _fail("unterminated string");
+    }
+    switch (_json[pos + 1]) {
+    case '"':
+    case '\\':
+    case '/':
+    case 'b':
+    case 'f':
+    case 'n':
+    case 'r':
+    case 't':
+      pos += 2;
+      break;
+    case 'u':
+      if (hexCodeUnit(_json.substr(pos + 2)) < 0) {
+        _pos = pos;
+        _fail("invalid \\u escape");
+      }
+      pos += 6;
+      break;
+    default:
+      _pos = pos;
+      _fail("invalid escape");
+    }
+  }
+}
+
+void JsonReader::_skipScalar() {
+  auto rest = _json.substr(_pos);
+  for (std::string_view literal : {"true", "false", "null"}) {
+    if (rest.starts_with(literal)) {
+      _pos += literal.size();
+      return;
+    }
+  }
+
+  auto start = _pos;
+  while (_pos < _json.size()) {
+    char c = _json[_pos];
+    if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+          c == 'e' || c == 'E')) {
+      break;
+    }
+    ++_pos;
+  }
+  if (_pos == start) {
+    _fail("unexpected character");
+  }
+}
+
+void JsonReader::_fail(std::string_view reason) const {
+  throw std::runtime_error("Invalid JSON at offset " + std::to_string(_pos) +
+                           ": " + std::string(reason));
+}
+
+void appendUnescaped(std::pmr::string &output, std::string_view escaped) {
+  while (!escaped.empty()) {
+    auto pos = escaped.find('\\');
+    output.append(escaped.substr(0, pos));
+    if (pos == std::string_view::npos || pos + 1 == escaped.size()) {
+      break;
+    }
+
+    char c = escaped[pos + 1];
+    escaped.remove_prefix(pos + 2);
+    switch (c) {
+    case 'b':
+      output.push_back('\b');
+      break;
+    case 'f':
+      output.push_back('\f');
+      break;
+    case 'n':
+      output.push_back('\n');
+      break;
+    case 'r':
+      output.push_back('\r');
+      break;
+    case 't':
+      output.push_back('\t');
+      break;
+    case 'u': {
+      auto unit = hexCodeUnit(escaped);
+      if (unit < 0) {
+        return;
+      }
+      escaped.remove_prefix(4);
+      uint32_t codePoint = static_cast<uint32_t>(unit);
+      if (unit >= 0xd800 && unit <= 0xdbff) {
+        // a high surrogate, only valid followed by a low one
+        int32_t low = escaped.starts_with("\\u")
+                          ? hexCodeUnit(escaped.substr(2))
+                          : -1;
+        if (low >= 0xdc00 && low <= 0xdfff) {
+          codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+          escaped.remove_prefix(6);
+        } else {
+          codePoint = 0xfffd;
+        }
+      } else if (unit >= 0xdc00 && unit <= 0xdfff) {
+        codePoint = 0xfffd;
+      }
+      appendUtf8(output, codePoint);
+      break;
+    }
+    default:
+      // '"', '\\' and '/' stand for themselves
+      output.push_back(c);
+      break;
+    }
+  }
+}
+} // namespace qabot::json_reader
@@ -0,0 +1,221 @@
+#include "json_writer/json_writer.hpp"
+
+#include <bit>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||           \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QABOT_ESCAPE_SSE2 1
+#include <immintrin.h>
+#endif
+
+// AVX2 is only compiled in where the compiler can target it per function,
+// the binary itself still runs on plain SSE2 machines
+#if defined(QABOT_ESCAPE_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define QABOT_ESCAPE_AVX2 1
+#endif
+
+namespace qabot::json_writer {
+namespace {
+// offset of the first byte that needs escaping in [data, data + size), size
+// if there is none
+using FindEscapeFn = size_t (*)(const char *data, size_t size);
+
+bool needsEscape(char c) {
+  return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+size_t findEscapeScalar(const char *data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    if (needsEscape(data[i])) {
+      return i;
+    }
+  }
+  return size;
+}
+
+#ifdef QABOT_ESCAPE_SSE2
+size_t findEscapeSse2(const char *data, size_t size) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i controlMax = _mm_set1_epi8(0x1f);
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    // there is no unsigned compare, a byte is <= 0x1f when the unsigned
+    // max with 0x1f doesn't change it
+    __m128i control =
+        _mm_cmpeq_epi8(_mm_max_epu8(block, controlMax), controlMax);
+    __m128i specials = _mm_or_si128(_mm_cmpeq_epi8(block, quote),
+                                    _mm_cmpeq_epi8(block, backslash));
+    __m128i matches = _mm_or_si128(specials, control);
+    if (auto mask = static_cast<uint32_t>(_mm_movemask_epi8(matches)); mask) {
+      return i + std::countr_zero(mask);
+    }
+  }
+  return i + findEscapeScalar(data + i, size - i);
+}
+#endif
+
+#ifdef QABOT_ESCAPE_AVX2
+__attribute__((target("avx2"))) size_t findEscapeAvx2(const char *data,
+                                                      size_t size) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i controlMax = _mm256_set1_epi8(0x1f);
+
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i control =
+        _mm256_cmpeq_epi8(_mm256_max_epu8(block, controlMax), controlMax);
+    __m256i matches =
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, quote),
+                                        _mm256_cmpeq_epi8(block, backslash)),
+                        control);
+    if (auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(matches));
+        mask) {
+      return i + std::countr_zero(mask);
+    }
+  }
+  // at most 31 bytes are left, one SSE2 step and the scalar tail. The SSE2
+  // code isn't VEX encoded, running it with the upper halves of the ymm
+  // registers dirty costs a state transition on every call.
+  _mm256_zeroupper();
+  return i + findEscapeSse2(data + i, size - i);
+}
+#endif
+
+FindEscapeFn selectFindEscape() {
+#ifdef QABOT_ESCAPE_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return &findEscapeAvx2;
+  }
+#endif
+#ifdef QABOT_ESCAPE_SSE2
+  return &findEscapeSse2;
+#else
+  return &findEscapeScalar;
+#endif
+}
+
+void appendEscapedChar(std::pmr::string &output, char c) {
+  switch (c) {
+  case '"':
+    output.append("\\\"");
+    break;
+  case '\\':
+    output.append("\\\\");
+    break;
+  case '\b':
+    output.append("\\b");
+    break;
+  case '\f':
+    output.append("\\f");
+    break;
+  case '\n':
+    output.append("\\n");
+    break;
+  case '\r':
+    output.append("\\r");
+    break;
+  case '\t':
+    output.append("\\t");
+    break;
+  default: {
+    constexpr char kHexDigits[] = "0123456789abcdef";
+    auto byte = static_cast<unsigned char>(c);
+    char escaped[] = {'\\', 'u', '0', '0', kHexDigits[byte >> 4],
+                      kHexDigits[byte & 0xf]};
+    output.append(escaped, sizeof(escaped));
+    break;
+  }
+  }
+}
+} // namespace
+
+size_t findEscape(std::string_view data, size_t from) {
+  static const FindEscapeFn findEscapeFn = selectFindEscape();
+  if (from >= data.size()) {
+    return std::string_view::npos;
+  }
+  auto offset = findEscapeFn(data.data() + from, data.size() - from);
+  return offset == data.size() - from ? std::string_view::npos
+                                      : from + offset;
+}
+
+void appendEscaped(std::pmr::string &output, std::string_view data) {
+  while (!data.empty()) {
+    auto pos = findEscape(data);
+    output.append(data.substr(0, pos));
+    if (pos == std::string_view::npos) {
+      break;
+    }
+    appendEscapedChar(output, data[pos]);
+    data.remove_prefix(pos + 1);
+  }
+}
+
+JsonWriter &JsonWriter::key(std::string_view key) {
+  _separate();
+  _output.push_back('"');
+  appendEscaped(_output, key);
+  _output.append("\":");
+  _isAfterKey = true;
+  return *this;
+}
+
+JsonWriter &JsonWriter::string(std::string_view value) {
+  _separate();
+  _output.push_back('"');
+  appendEscaped(_output, value);
+  _output.push_back('"');
+  return *this;
+}
+
+JsonWriter &JsonWriter::escapedString(std::string_view value) {
+  _separate();
+  _output.push_back('"');
+  _output.append(value);
+  _output.push_back('"');
+  return *this;
+}
+
+JsonWriter &JsonWriter::_open(char bracket) {
+  if (_depth == kMaxDepth) {
+    throw std::runtime_error("JSON nesting too deep");
+  }
+  _separate();
+  _output.push_back(bracket);
+  _hasElements &= ~(uint64_t{1} << _depth);
+  ++_depth;
+  return *this;
+}
+
+JsonWriter &JsonWriter::_close(char bracket) {
+  --_depth;
+  _output.push_back(bracket);
+  return *this;
+}
+
+void JsonWriter::_separate() {
+  if (_isAfterKey) {
+    // the value of a member, the colon is already there
+    _isAfterKey = false;
+    return;
+  }
+  if (_depth == 0) {
+    return;
+  }
+  auto bit = uint64_t{1} << (_depth - 1);
+  if (_hasElements & bit) {
+    _output.push_back(',');
+  } else {
+    _hasElements |= bit;
+  }
+}
+} // namespace qabot::json_writer
@@ -1,23 +1,106 @@
+#include <csignal>
+#include <future>
 #include <iostream>
 
 #include "env_reader/env_reader.hpp"
 #include "event_manager/event_manager.hpp"
-#include "scope_manager/scope_manager.hpp"
 #include "server/server.hpp"
+#include "socket/tls_context.hpp"
+#ifdef QABOT_IO_URING
+#include "uring/uring.hpp"
+#endif
 
 int main() {
   // read env
   qabot::env_reader::EnvReader::getInstance().readEnv("../.env");
 
+  // one event loop worker per core unless WORKER_THREADS says otherwise
+  if (auto workerThreads =
+          qabot::env_reader::EnvReader::getInstance().getEnv("WORKER_THREADS");
+      !workerThreads.empty()) {
+    qabot::event_manager::EventManager::setWorkerCount(
+        std::stoul(workerThreads));
+  }
+
+  // SO_REUSEPORT listeners per worker, 0 (the default) shares one listener.
+  // Sharded workers are pinned so a connection stays on the accepting core.
+  if (auto listenersPerWorker =
+          qabot::env_reader::EnvReader::getInstance().getEnv(
+              "LISTENERS_PER_WORKER");
+      !listenersPerWorker.empty() && std::stoul(listenersPerWorker) > 0) {
+    qabot::server::Server::setListenersPerWorker(
+        std::stoul(listenersPerWorker));
+    qabot::event_manager::EventManager::setPinned(true);
+  }
+
+  // pending connections each listener may queue in the kernel
+  if (auto listenBacklog =
+          qabot::env_reader::EnvReader::getInstance().getEnv("LISTEN_BACKLOG");
+      !listenBacklog.empty()) {
+    qabot::server::Server::setListenBacklog(std::stoi(listenBacklog));
+  }
+
+#ifdef QABOT_IO_URING
+  // built with io_uring, IO_URING=0 goes back to epoll and plain syscalls
+  if (qabot::env_reader::EnvReader::getInstance().getEnv("IO_URING") == "0") {
+    qabot::uring::Uring::setEnabled(false);
+  }
+#endif
+
+  // KERNEL_TLS=1 lets OpenSSL offload upstream TLS records to the kernel,
+  // sessions it can't offload stay in userspace
+  if (qabot::env_reader::EnvReader::getInstance().getEnv("KERNEL_TLS") == "1") {
+    qabot::socket::TlsContext::setKernelTls(true);
+  }
+
+  // bytes a single client request may take, 1 MB unless MAX_REQUEST_SIZE
+  // says otherwise
+  if (auto maxRequestSize =
+          qabot::env_reader::EnvReader::getInstance().getEnv(
+              "MAX_REQUEST_SIZE");
+      !maxRequestSize.empty()) {
+    qabot::server::Server::setMaxRequestSize(std::stoul(maxRequestSize));
+  }
+
+  // per-phase deadlines in seconds, the defaults are in Timeouts
+  qabot::server::Timeouts timeouts;
+  auto readTimeout = [](const std::string &name,
+                        std::chrono::milliseconds &timeout) {
+    if (auto seconds = qabot::env_reader::EnvReader::getInstance().getEnv(name);
+        !seconds.empty()) {
+      timeout = std::chrono::seconds(std::stoul(seconds));
+    }
+  };
+  readTimeout("CONNECT_TIMEOUT", timeouts.connect);
+  readTimeout("TLS_HANDSHAKE_TIMEOUT", timeouts.tlsHandshake);
+  readTimeout("FIRST_BYTE_TIMEOUT", timeouts.firstByte);
+  readTimeout("UPSTREAM_IDLE_TIMEOUT", timeouts.upstreamIdle);
+  // how long a keep-alive connection may sit idle between requests
+  readTimeout("KEEP_ALIVE_TIMEOUT", timeouts.clientIdle);
+  qabot::server::Server::setTimeouts(timeouts);
+
+  // requests served on one keep-alive connection
+  if (auto maxKeepAliveRequests =
+          qabot::env_reader::EnvReader::getInstance().getEnv(
+              "MAX_KEEP_ALIVE_REQUESTS");
+      !maxKeepAliveRequests.empty()) {
+    qabot::server::Server::setMaxKeepAliveRequests(
+        std::stoul(maxKeepAliveRequests));
+  }
+
+#ifndef _WIN32
+  // writing to a connection the peer already closed (e.g. the close_notify
+  // of an expired upstream connection) must fail with EPIPE, not kill us
+  std::signal(SIGPIPE, SIG_IGN);
+#endif
+
   // Start the server
   qabot::server::Server::getInstance().start();
 
-  // Keep the main thread alive
-  while (true) {
-    // Clean up completed tasks
-    std::this_thread::sleep_for(std::chrono::seconds(2));
-    qabot::scope_manager::ScopeManager::getInstance().cleanUpTask();
-  }
+  // Keep the main thread alive. Sessions free themselves when they finish,
+  // so there is nothing to do here but wait.
+  std::promise<void> forever;
+  forever.get_future().wait();
 
   return 0;
 }
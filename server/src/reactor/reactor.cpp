@@ -0,0 +1,382 @@
+#include "reactor/reactor.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif !defined(_WIN32)
+#include <poll.h>
+#endif
+
+namespace qabot::reactor {
+namespace {
+constexpr int kMaxEventsPerWait = 64;
+} // namespace
+
+void Reactor::_collectReady(NativeHandle handle, bool readable, bool writable,
+                            std::vector<Wakeup> &ready) {
+  auto it = _watches.find(handle);
+  if (it == _watches.end()) {
+    return;
+  }
+
+  auto &watch = it->second;
+  if (readable && watch.readable.onReady.callback) {
+    _take(watch.readable, ready);
+  }
+  if (writable && watch.writable.onReady.callback) {
+    _take(watch.writable, ready);
+  }
+
+#ifdef __linux__
+  if (!watch.isNotifyOnly &&
+      (watch.readable.onReady.callback || watch.writable.onReady.callback)) {
+    // one-shot registrations are disabled after they fire, re-arm for the
+    // direction that is still waiting
+    _arm(handle, watch);
+  }
+#endif
+}
+
+Clock::time_point Reactor::_collectExpired(std::vector<Wakeup> &ready) {
+  _timers.advance(Clock::now(), [&ready](timer_wheel::Timer &timer) {
+    // every timer in the wheel is a waiter. A watch whose deadline passed
+    // may stay armed, if it fires later there is no callback left to queue.
+    auto &waiter = static_cast<Waiter &>(timer);
+    ready.push_back({waiter.onReady, waiter.workerIndex});
+    waiter.onReady = {};
+  });
+  _pollWakeUp = _timers.nextWakeUp().value_or(kNoDeadline);
+  return _pollWakeUp;
+}
+
+void Reactor::_take(Waiter &waiter, std::vector<Wakeup> &ready) {
+  _timers.cancel(waiter);
+  ready.push_back({waiter.onReady, waiter.workerIndex});
+  waiter.onReady = {};
+}
+
+bool Reactor::_register(Waiter &waiter, event_manager::Event onReady,
+                        Clock::time_point deadline) {
+  waiter.onReady = onReady;
+  waiter.workerIndex = event_manager::EventManager::currentWorker();
+  if (deadline == kNoDeadline) {
+    _timers.cancel(waiter);
+    return false;
+  }
+  _timers.arm(waiter, deadline);
+  if (deadline >= _pollWakeUp) {
+    return false;
+  }
+  _pollWakeUp = deadline;
+  return true;
+}
+
+void Reactor::_dispatch(std::vector<Wakeup> &ready) {
+  for (auto &wakeup : ready) {
+    event_manager::EventManager::getInstance().addEvent(wakeup.onReady,
+                                                        wakeup.workerIndex);
+  }
+  ready.clear();
+}
+
+void Reactor::schedule(Waiter &waiter, Clock::time_point deadline,
+                       event_manager::Event onReady) {
+  bool isEarlier = false;
+  {
+    std::lock_guard<std::mutex> lock(_watchMutex);
+    isEarlier = _register(waiter, onReady, deadline);
+  }
+  if (isEarlier) {
+    _wake();
+  }
+}
+
+void Reactor::cancel(Waiter &waiter) {
+  std::lock_guard<std::mutex> lock(_watchMutex);
+  _timers.cancel(waiter);
+  waiter.onReady = {};
+}
+
+void Reactor::notify(NativeHandle handle, Interest interest) {
+  std::vector<Wakeup> ready;
+  {
+    std::lock_guard<std::mutex> lock(_watchMutex);
+    auto &watch = _watches[handle];
+    auto &waiter = interest == Interest::Read ? watch.readable : watch.writable;
+    if (waiter.onReady.callback) {
+      _take(waiter, ready);
+    } else if (interest == Interest::Read) {
+      watch.isReadableNotified = true;
+    } else {
+      watch.isWritableNotified = true;
+    }
+  }
+  _dispatch(ready);
+}
+
+void Reactor::setNotifyOnly(NativeHandle handle, bool isNotifyOnly) {
+  std::lock_guard<std::mutex> lock(_watchMutex);
+  auto &watch = _watches[handle];
+  watch.isNotifyOnly = isNotifyOnly;
+  if (!isNotifyOnly) {
+    // meant for the handle that is about to be closed
+    watch.isReadableNotified = false;
+    watch.isWritableNotified = false;
+  }
+}
+
+bool Reactor::_takeNotified(Watch &watch, Interest interest,
+                            std::vector<Wakeup> &ready) {
+  auto &isNotified = interest == Interest::Read ? watch.isReadableNotified
+                                                : watch.isWritableNotified;
+  if (!isNotified) {
+    return false;
+  }
+  isNotified = false;
+  _take(interest == Interest::Read ? watch.readable : watch.writable, ready);
+  return true;
+}
+
+#ifdef __linux__
+Reactor::Reactor() {
+  _epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (_epollFd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Failed to create epoll instance");
+  }
+
+  _wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (_wakeFd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Failed to create wake up eventfd");
+  }
+
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = _wakeFd;
+  epoll_ctl(_epollFd, EPOLL_CTL_ADD, _wakeFd, &event);
+
+  _pollThread = std::thread([this] { _pollLoop(); });
+}
+
+Reactor::~Reactor() {
+  _isRunning = false;
+  _wake();
+  if (_pollThread.joinable()) {
+    _pollThread.join();
+  }
+  ::close(_wakeFd);
+  ::close(_epollFd);
+}
+
+void Reactor::watch(NativeHandle handle, Interest interest,
+                    event_manager::Event onReady, Clock::time_point deadline) {
+  bool isEarlier = false;
+  std::vector<Wakeup> ready;
+  {
+    std::lock_guard<std::mutex> lock(_watchMutex);
+    auto &watch = _watches[handle];
+    auto &waiter = interest == Interest::Read ? watch.readable : watch.writable;
+    isEarlier = _register(waiter, onReady, deadline);
+    if (!_takeNotified(watch, interest, ready) && !watch.isNotifyOnly) {
+      _arm(handle, watch);
+    }
+  }
+  if (isEarlier) {
+    _wake();
+  }
+  _dispatch(ready);
+}
+
+void Reactor::_wake() {
+  uint64_t one = 1;
+  [[maybe_unused]] auto written = ::write(_wakeFd, &one, sizeof(one));
+}
+
+void Reactor::_arm(NativeHandle handle, const Watch &watch) {
+  epoll_event event{};
+  event.events = EPOLLONESHOT;
+  if (watch.readable.onReady.callback) {
+    event.events |= EPOLLIN | EPOLLRDHUP;
+  }
+  if (watch.writable.onReady.callback) {
+    event.events |= EPOLLOUT;
+  }
+  event.data.fd = handle;
+
+  // a handle stays registered (but disabled) after its one-shot fired, so
+  // try to modify first and only add it when the kernel doesn't know it
+  if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, handle, &event) == 0) {
+    return;
+  }
+  if (errno == ENOENT &&
+      epoll_ctl(_epollFd, EPOLL_CTL_ADD, handle, &event) == 0) {
+    return;
+  }
+  throw std::system_error(errno, std::generic_category(),
+                          "Failed to register socket with epoll");
+}
+
+void Reactor::_pollLoop() {
+  epoll_event events[kMaxEventsPerWait];
+  std::vector<Wakeup> ready;
+
+  while (_isRunning) {
+    int timeoutMs = -1;
+    {
+      std::lock_guard<std::mutex> lock(_watchMutex);
+      if (auto wakeUp = _collectExpired(ready); wakeUp != kNoDeadline) {
+        // round up, waking a little early would only spin until it's time
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+            wakeUp - Clock::now());
+        timeoutMs = static_cast<int>(std::clamp<int64_t>(
+            wait.count(), 0, std::numeric_limits<int>::max()));
+      }
+    }
+    _dispatch(ready);
+
+    int count = epoll_wait(_epollFd, events, kMaxEventsPerWait, timeoutMs);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "epoll_wait error: " << strerror(errno) << std::endl;
+      break;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(_watchMutex);
+      for (int i = 0; i < count; ++i) {
+        if (events[i].data.fd == _wakeFd) {
+          // reset the eventfd, the timers are looked at again anyway
+          uint64_t value;
+          [[maybe_unused]] auto bytesRead =
+              ::read(_wakeFd, &value, sizeof(value));
+          continue;
+        }
+        // errors and hang ups wake both directions, the retried operation
+        // will report what actually happened
+        const auto flags = events[i].events;
+        const bool failed = flags & (EPOLLERR | EPOLLHUP);
+        _collectReady(events[i].data.fd,
+                      failed || (flags & (EPOLLIN | EPOLLRDHUP)),
+                      failed || (flags & EPOLLOUT), ready);
+      }
+    }
+
+    _dispatch(ready);
+  }
+}
+#else
+// Portable fallback for platforms without epoll. The watched handles are
+// polled with a short timeout so newly added watches are picked up quickly.
+namespace {
+constexpr int kPollTimeoutMs = 10;
+} // namespace
+
+Reactor::Reactor() {
+  _pollThread = std::thread([this] { _pollLoop(); });
+}
+
+Reactor::~Reactor() {
+  _isRunning = false;
+  _watchCondition.notify_all();
+  if (_pollThread.joinable()) {
+    _pollThread.join();
+  }
+}
+
+void Reactor::watch(NativeHandle handle, Interest interest,
+                    event_manager::Event onReady, Clock::time_point deadline) {
+  std::vector<Wakeup> ready;
+  {
+    std::lock_guard<std::mutex> lock(_watchMutex);
+    auto &watch = _watches[handle];
+    auto &waiter = interest == Interest::Read ? watch.readable : watch.writable;
+    // the poll below wakes up often enough to notice the deadline
+    _register(waiter, onReady, deadline);
+    _takeNotified(watch, interest, ready);
+  }
+  _watchCondition.notify_one();
+  _dispatch(ready);
+}
+
+void Reactor::_wake() { _watchCondition.notify_one(); }
+
+size_t Reactor::_waitingCount() const {
+  size_t count = 0;
+  for (const auto &[handle, watch] : _watches) {
+    if (watch.readable.onReady.callback || watch.writable.onReady.callback) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+void Reactor::_pollLoop() {
+#ifdef _WIN32
+  using PollFd = WSAPOLLFD;
+#else
+  using PollFd = pollfd;
+#endif
+  std::vector<PollFd> pollFds;
+  std::vector<Wakeup> ready;
+
+  while (_isRunning) {
+    pollFds.clear();
+    {
+      std::unique_lock<std::mutex> lock(_watchMutex);
+      _watchCondition.wait(lock, [this] {
+        return !_isRunning || _waitingCount() > 0 || _timers.size() > 0;
+      });
+      auto wakeUp = _collectExpired(ready);
+      for (const auto &[handle, watch] : _watches) {
+        if (watch.isNotifyOnly || (!watch.readable.onReady.callback &&
+                                   !watch.writable.onReady.callback)) {
+          continue;
+        }
+        PollFd pollFd{};
+        pollFd.fd = handle;
+        pollFd.events = (watch.readable.onReady.callback ? POLLIN : 0) |
+                        (watch.writable.onReady.callback ? POLLOUT : 0);
+        pollFds.push_back(pollFd);
+      }
+      if (pollFds.empty() && ready.empty() && wakeUp != kNoDeadline) {
+        // only timers are waiting, nothing to poll until the next one
+        _watchCondition.wait_until(lock, wakeUp);
+        continue;
+      }
+    }
+    _dispatch(ready);
+
+#ifdef _WIN32
+    int count = WSAPoll(pollFds.data(), pollFds.size(), kPollTimeoutMs);
+#else
+    int count = ::poll(pollFds.data(), pollFds.size(), kPollTimeoutMs);
+#endif
+    if (count <= 0) {
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(_watchMutex);
+      for (const auto &pollFd : pollFds) {
+        const bool failed = pollFd.revents & (POLLERR | POLLHUP);
+        _collectReady(pollFd.fd, failed || (pollFd.revents & POLLIN),
+                      failed || (pollFd.revents & POLLOUT), ready);
+      }
+    }
+
+    _dispatch(ready);
+  }
+}
+#endif
+} // namespace qabot::reactor
@@ -1,47 +1,126 @@
 #include "server/server.hpp"
+#include <array>
+#include <charconv>
 #include <coroutine>
+#include <exception>
 #include <memory>
+#include <memory_resource>
+#include <string_view>
 #include <utility>
+#include <vector>
 
+#include "arena/arena.hpp"
 #include "awaitable/awaitable.hpp"
+#include "buffered_reader/buffered_reader.hpp"
+#include "chat_request/chat_request.hpp"
+#include "connection_pool/connection_pool.hpp"
+#include "dns_resolver/dns_resolver.hpp"
 #include "env_reader/env_reader.hpp"
+#include "event_manager/event_manager.hpp"
+#include "http/header_field.hpp"
 #include "http/http.hpp"
-#include "http/http_parse.hpp"
-#include "http/http_serialize.hpp"
-#include "nlohmann/json.hpp"
-#include "scope_manager/scope_manager.hpp"
+#include "http/http_scan.hpp"
+#include "http/request_parser.hpp"
+#include "json_reader/json_reader.hpp"
+#include "metrics/metrics.hpp"
+#include "http/message_template.hpp"
+#include "socket/io_error.hpp"
 #include "socket/secure_socket.hpp"
 #include "socket/socket.hpp"
 #include "socket/socket_exception.hpp"
+#include "write_queue/write_queue.hpp"
 
 #define AI_SERVER_URL "generativelanguage.googleapis.com"
 #define HTTPS_PORT 443
+#define LISTEN_PORT 38763
 namespace qabot::server {
+namespace {
+using UpstreamPool = qabot::connection_pool::ConnectionPool<SocketImpl>;
+using ClientReader =
+    qabot::buffered_reader::BufferedReader<qabot::socket::Socket<SocketImpl>>;
+
+// Request line and headers of every upstream request, only the model and the
+// body change. Built on first use, after the env file was read.
+const qabot::http::MessageTemplate &upstreamRequestTemplate() {
+  static const qabot::http::MessageTemplate instance({
+      // absolute form, the path part goes to the AI server
+      "POST https://" AI_SERVER_URL "/v1beta/models/",
+      ":streamGenerateContent?alt=sse&key=" +
+          qabot::env_reader::EnvReader::getInstance().getEnv("API_KEY") +
+          " HTTP/1.1\r\n"
+          "Host: " AI_SERVER_URL "\r\n"
+          "Content-Type: application/json\r\n",
+  });
+  return instance;
+}
+
+const qabot::http::MessageTemplate &metricsResponseTemplate() {
+  static const qabot::http::MessageTemplate instance({
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Connection: ",
+      "\r\n",
+  });
+  return instance;
+}
+
+// a response that isn't an event stream is passed on with its body
+const qabot::http::MessageTemplate &relayedResponseTemplate() {
+  static const qabot::http::MessageTemplate instance({
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: ",
+      "\r\n"
+      "Connection: ",
+      "\r\n",
+  });
+  return instance;
+}
+} // namespace
+
 void Server::start() {
-  // Bind the socket to the address and port
-  _serverSocket.bind("0.0.0.0", 38763);
-  _serverSocket.listen(5);
+  using qabot::event_manager::EventManager;
 
-  // Start the server loop
-  auto serverTask = _serverLoop();
-  // move serverTask into scopeManager
-  qabot::scope_manager::ScopeManager::getInstance() << std::move(serverTask);
+  // Start the server loops, they run detached on the event loop
+  if (_listenersPerWorker == 0) {
+    _serverLoop(_listen(false), EventManager::kAnyWorker);
+    return;
+  }
+  auto workerCount = EventManager::getInstance().workerCount();
+  for (size_t worker = 0; worker < workerCount; ++worker) {
+    for (size_t i = 0; i < _listenersPerWorker; ++i) {
+      _serverLoop(_listen(true), worker);
+    }
+  }
+}
+
+Server::ServerSocket &Server::_listen(bool isSharded) {
+  auto &listener = *_listeners.emplace_back(std::make_unique<ServerSocket>(
+      qabot::socket::TransportProtocol::TCP, qabot::socket::IPVersion::IPv4));
+  if (isSharded && !listener.setReusePort()) {
+    throw std::runtime_error("SO_REUSEPORT is not supported here");
+  }
+  // Bind the socket to the address and port
+  listener.bind("0.0.0.0", LISTEN_PORT);
+  listener.listen(_listenBacklog);
+  return listener;
 }
 
-qabot::task::Task<void> Server::_serverLoop() {
+qabot::task::DetachedTask Server::_serverLoop(ServerSocket &listener,
+                                              size_t workerIndex) {
+  // a sharded listener accepts on its own worker, the sessions it starts
+  // run there too
+  co_await qabot::awaitable::resumeOn(workerIndex);
   std::cout << "Start listening\n";
 
   while (true) {
     try {
       auto client = std::move(co_await qabot::awaitable::Awaitable(
-          [this]() { return _serverSocket.accept(); }));
-
-      auto clientTask = _clientLoop(std::move(client));
-      // move clientTask into scopeManager
-      // so it won't be destructed when the function returns
-      // or goes to next loop
-      qabot::scope_manager::ScopeManager::getInstance()
-          << std::move(clientTask);
+          listener.getSocketFD(),
+          [&listener]() { return listener.accept(); }));
+
+      // the session frees itself once the client is gone
+      _clientLoop(std::move(client));
+      _acceptBatch(listener);
     } catch (const std::exception &e) {
       std::cerr << "Error accepting connection: " << e.what() << std::endl;
       continue;
@@ -49,7 +128,19 @@ qabot::task::Task<void> Server::_serverLoop() {
   }
 }
 
-qabot::task::Task<void>
+// Takes the connections queued up behind the one just accepted without going
+// back to the reactor, the first would-block ends the batch
+void Server::_acceptBatch(ServerSocket &listener) {
+  for (size_t i = 1; i < kAcceptBatchSize; ++i) {
+    auto client = listener.accept();
+    if (!client) {
+      return;
+    }
+    _clientLoop(std::move(*client));
+  }
+}
+
+qabot::task::DetachedTask
 Server::_clientLoop(qabot::socket::Socket<SocketImpl> &&clientSocket) {
   // Create a shared pointer to the client socket
   // This allows us to share the socket between the coroutine and the main
@@ -57,139 +148,210 @@ Server::_clientLoop(qabot::socket::Socket<SocketImpl> &&clientSocket) {
   auto clientSocketPtr = std::make_shared<qabot::socket::Socket<SocketImpl>>(
       std::move(clientSocket));
 
-  // Create a secure socket for sending data to the AI server
-  auto sendingSocketPtr =
-      std::make_shared<qabot::socket::SecureSocket<SocketImpl>>(
-          qabot::socket::TransportProtocol::TCP,
-          qabot::socket::IPVersion::IPv4);
-  try {
-    // connect to the AI server
-    co_await qabot::awaitable::Awaitable<void>([sendingSocketPtr]() {
-      sendingSocketPtr->connect(AI_SERVER_URL, HTTPS_PORT);
-    });
+  // everything for the client goes through here, a short write is queued
+  // instead of lost and a slow client throttles the relay
+  qabot::write_queue::WriteQueue clientWriter(*clientSocketPtr);
+  // sent after an error, a handler can't co_await
+  std::string errorResponse;
+  // set once the first byte of the current response may have gone out, an
+  // error response can't be sent behind it anymore
+  bool isResponseStarted = false;
 
-    // Keep receiving messages from the client
+  try {
+    // requests are parsed straight out of the read buffer, a request that
+    // was pipelined behind the current one stays buffered for the next turn
+    ClientReader clientReader(*clientSocketPtr, ClientReader::kDefaultCapacity,
+                              _maxRequestSize);
+    qabot::http::RequestParser requestParser(_maxRequestSize);
+
+    // requests answered on this connection so far
+    size_t requestCount = 0;
+
+    // Keep receiving messages from the client. Responses go out in the order
+    // the requests came in, the next request is only looked at once the
+    // current response was written.
     while (true) {
-      auto clientMessage = co_await qabot::awaitable::Awaitable(
-          [clientSocketPtr]() -> std::string {
-            return clientSocketPtr->receive(1024 * 1024 * 80);
-          });
+      requestParser.reset();
+      isResponseStarted = false;
+      // a keep-alive client gets this long to send its next request
+      auto requestDeadline =
+          qabot::reactor::Clock::now() + _timeouts.clientIdle;
+      bool isDisconnected = false;
+      bool isTimedOut = false;
+      while (requestParser.parse(clientReader.buffered()) ==
+             qabot::http::ParseStatus::Incomplete) {
+        size_t bytesReceived = 0;
+        try {
+          bytesReceived = co_await clientReader.fill(requestDeadline);
+        } catch (const std::system_error &e) {
+          if (e.code() != std::errc::timed_out) {
+            throw;
+          }
+          isTimedOut = true;
+        }
+        if (bytesReceived == 0) {
+          isDisconnected = true;
+          break;
+        }
+      }
 
-      if (clientMessage.empty()) {
+      if (isDisconnected) {
         // Client disconnected
-        std::cout << "Client disconnected." << std::endl;
+        std::cout << (isTimedOut ? "Client idle for too long, closing."
+                                 : "Client disconnected.")
+                  << std::endl;
         break;
       }
 
-      std::cout << clientMessage << std::endl;
-
-      auto httpRequest = qabot::http::parseRequest(clientMessage);
-
-      auto jsonMessage = nlohmann::json::parse(httpRequest.body);
-
-      std::string modelName = jsonMessage["model_name"];
-      std::string apiKey =
-          env_reader::EnvReader::getInstance().getEnv("API_KEY");
-      std::string prompt = jsonMessage["prompt"];
-      std::string message = jsonMessage["message"];
-
-      bool isChunked = false;
-      std::string path = "/v1beta/models/" + modelName +
-                         ":streamGenerateContent?alt=sse&key=" + apiKey;
-      std::string fullUrl = "https://" + std::string(AI_SERVER_URL) +
-                            path; // For serializeRequest
-
-      nlohmann::json contentArray = nlohmann::json::array();
-
-      const auto &contextArray = jsonMessage["context"];
-
-      for (const auto &context : contextArray) {
-        for (auto const &[role, text] : context.items()) {
-          contentArray.push_back({
-              {"role", role},
-              {
-                  "parts",
-                  {
-                      {
-                          {"text", text.get<std::string>()},
-                      },
-                  },
-              },
-          });
+      const auto &head = requestParser.head();
+      // close once the client asks for it or used up its requests
+      ++requestCount;
+      bool isKeepAlive =
+          head.keepAlive() && requestCount < _maxKeepAliveRequests;
+      std::string_view connection = isKeepAlive ? "keep-alive" : "close";
+
+      if (head.method == qabot::http::RequestMethod::Get &&
+          head.path == "/metrics") {
+        std::pmr::string metricsResponse;
+        metricsResponseTemplate().render(
+            metricsResponse, {connection},
+            qabot::metrics::Metrics::getInstance().render());
+        clientReader.consume(requestParser.messageSize());
+
+        isResponseStarted = true;
+        co_await clientWriter.asyncWriteAll(metricsResponse);
+        if (!isKeepAlive) {
+          break;
         }
+        continue;
       }
 
-      // push back the last message from user
-      contentArray.push_back({
-          {"role", "user"},
-          {
-              "parts",
-              {
-                  {
-                      {"text", message},
-                  },
-              },
-          },
-      });
-      nlohmann::json requestJson = {
-          {"system_instruction", {{"parts", {{{"text", prompt}}}}}},
-          {"contents", contentArray}};
-
-      auto request = qabot::http::serializeRequest(
-          qabot::http::RequestMethod::Post,
-          fullUrl, // Pass only the path part to serializeRequest
-          {
-              {"Content-Type",
-               contentTypeToString(qabot::http::ContentType::Json)},
-          },
-          requestJson.dump());
+      const auto &bodyParts = requestParser.bodyParts();
+      if (bodyParts.empty()) {
+        throw std::runtime_error("Empty body content");
+      }
+      // the upstream request and the strings it is built from live in here
+      // and are released together at the end of this iteration
+      qabot::arena::RequestArena arena;
+
+      std::string_view body = bodyParts.front();
+      std::pmr::string joinedBody(arena.allocator());
+      if (bodyParts.size() > 1) {
+        // chunked body, put the chunks back together
+        joinedBody.reserve(requestParser.bodySize());
+        for (auto part : bodyParts) {
+          joinedBody += part;
+        }
+        body = joinedBody;
+      }
+      // the fields are views into the body, which stays in the receive
+      // buffer until the upstream request is built
+      auto chat =
+          qabot::chat_request::parseChatRequest(body, arena.allocator());
+
+      // the model goes into the URL, as plain text
+      std::pmr::string modelName(arena.allocator());
+      qabot::json_reader::appendUnescaped(modelName, chat.modelName);
+
+      // the conversation is copied once, straight from the client's body into
+      // the arena
+      std::pmr::string upstreamBody(arena.allocator());
+      upstreamBody.reserve(requestParser.bodySize() + 256);
+      qabot::chat_request::writeUpstreamBody(upstreamBody, chat);
+
+      std::pmr::string request(arena.allocator());
+      upstreamRequestTemplate().render(request, {modelName}, upstreamBody);
+      // nothing points into the client's request anymore, let the reader
+      // reuse its bytes
+      clientReader.consume(requestParser.messageSize());
+
+      // borrow a connection to the AI server, only the first request to it
+      // pays for the handshakes
+      auto upstream =
+          UpstreamPool::getInstance().acquire(AI_SERVER_URL, HTTPS_PORT);
+      auto *upstreamPtr = upstream.get();
+      if (!upstream->isConnected) {
+        // the lookup runs on the resolver thread, the worker keeps going
+        auto endpoints =
+            co_await qabot::dns_resolver::DnsResolver::getInstance().resolve(
+                AI_SERVER_URL, HTTPS_PORT, qabot::socket::IPVersion::IPv4);
+        // the records come rotated, an address that refuses or doesn't
+        // answer in time hands over to the next one
+        std::exception_ptr connectError;
+        for (const auto &endpoint : endpoints) {
+          if (connectError) {
+            // a socket whose connect failed can't start another one
+            upstream = std::make_unique<UpstreamPool::Connection>(
+                AI_SERVER_URL, HTTPS_PORT);
+            upstreamPtr = upstream.get();
+          }
+          try {
+            co_await qabot::awaitable::withTimeout(
+                qabot::awaitable::Awaitable(
+                    upstreamPtr->socket.getSocketFD(),
+                    [upstreamPtr, endpoint]() {
+                      return upstreamPtr->socket.connectTransport(
+                          AI_SERVER_URL, endpoint);
+                    }),
+                _timeouts.connect);
+            connectError = nullptr;
+            break;
+          } catch (const std::exception &) {
+            connectError = std::current_exception();
+          }
+        }
+        if (connectError) {
+          std::rethrow_exception(connectError);
+        }
+        co_await qabot::awaitable::withTimeout(
+            qabot::awaitable::Awaitable(
+                upstreamPtr->socket.getSocketFD(),
+                [upstreamPtr]() { return upstreamPtr->socket.handshake(); }),
+            _timeouts.tlsHandshake);
+        upstream->isConnected = true;
+      }
+      auto &upstreamReader = upstream->reader;
+
+      co_await upstream->writer.asyncWriteAll(request);
 
-      std::cout << "Request: " << request << std::endl;
+      // whether the connection can go back to the pool after this response
+      bool isReusable = true;
+      qabot::http::ResponseFraming framing;
+      std::pmr::string contentType("application/json", arena.allocator());
 
-      co_await qabot::awaitable::Awaitable(
-          [sendingSocketPtr, request]() { sendingSocketPtr->send(request); });
+      // the status line may take as long as the model needs to start
+      // answering, everything after it has to keep coming
+      auto readTimeout = _timeouts.firstByte;
 
       // start parsing the header line by line
       while (true) {
-        std::string headerLine;
-        while (true) {
-          auto nowChar =
-              co_await qabot::awaitable::Awaitable([sendingSocketPtr]() {
-                char result = sendingSocketPtr->receive(1)[0];
-
-                return result;
-              });
-
-          if (nowChar == '\n') {
-            break;
-          } else if (nowChar == '\r') {
-            continue;
-          } else {
-            headerLine += nowChar;
-          }
-        }
-        std::cout << headerLine << std::endl;
+        auto headerLine = co_await qabot::awaitable::withTimeout(
+            upstreamReader.readLine(), readTimeout);
+        readTimeout = _timeouts.upstreamIdle;
         if (headerLine.empty()) {
           break; // End of headers
         } // end of header line
 
         // Parse the header line
 
-        auto colonPos = headerLine.find(':');
-        if (colonPos != std::string::npos) {
-          std::string headerName = headerLine.substr(0, colonPos);
-          std::string headerValue =
-              headerLine.substr(colonPos + 1); // Skip the colon
-          // Trim leading whitespace from headerValue
-          headerValue.erase(0, headerValue.find_first_not_of(" \t"));
-          // Store or process the header as needed
-
-          if (headerName == "Transfer-Encoding" && headerValue == "chunked") {
-            isChunked = true;
+        auto colonPos = qabot::http::findColonOrNewline(headerLine);
+        if (colonPos != std::string_view::npos) {
+          auto headerName = headerLine.substr(0, colonPos);
+          auto headerValue = qabot::http::trim(
+              headerLine.substr(colonPos + 1)); // Skip the colon
+
+          // names are case-insensitive, a pooled connection that misses
+          // its framing would wait for a close that never comes
+          if (qabot::http::equalsIgnoreCase(headerName, "Content-Type")) {
+            contentType = headerValue;
+          } else if (!framing.addHeader(headerName, headerValue)) {
+            // where the body ends is anybody's guess
+            isReusable = false;
+            throw std::runtime_error("Invalid Content-Length from upstream");
           }
         } else {
           // first line of header
-          std::stringstream lineStream(headerLine);
+          std::stringstream lineStream{std::string(headerLine)};
           std::string version;
           lineStream >> version;
           std::string statusCode;
@@ -202,94 +364,106 @@ Server::_clientLoop(qabot::socket::Socket<SocketImpl> &&clientSocket) {
           }
         }
       } // End of headers
+      if (framing.isClose) {
+        isReusable = false;
+      }
 
       // 3. Read the response body
-      std::string responseBody;
-      if (isChunked) {
+      if (framing.isChunked) {
         // If the response is chunked, we need to send initial headers
         // to the client
-        std::stringstream initialHeadersSs;
-        initialHeadersSs << "HTTP/1.1 200 OK\r\n";
-        initialHeadersSs << "Content-Type: "
-                         << "text/event-stream\r\n";
-
-        initialHeadersSs << "Transfer-Encoding: chunked\r\n";
-        initialHeadersSs << "Connection: keep-alive\r\n";
-
-        initialHeadersSs << "\r\n";
-        std::string initialResponseHeaders = initialHeadersSs.str();
-
-        co_await qabot::awaitable::Awaitable<void>(
-            [clientSocketPtr, initialResponseHeaders]() {
-              clientSocketPtr->send(initialResponseHeaders);
-            });
-        // read the chunk size
-        // first read one line
+        isResponseStarted = true;
+        co_await clientWriter.asyncWriteAll(
+            isKeepAlive ? qabot::http::kEventStreamResponseHead
+                        : qabot::http::kEventStreamResponseHeadClose);
+        // the chunks are relayed as they are, only the size line is
+        // written again, into this buffer
+        char chunkHeader[sizeof(size_t) * 2 + 2];
         while (true) {
           // read the chunk size
-          std::string chunkSizeLine;
-          while (true) {
-            auto nowChar = co_await qabot::awaitable::Awaitable(
-                [sendingSocketPtr]() -> char {
-                  return sendingSocketPtr->receive(1)[0];
-                });
-            if (nowChar == '\n') {
-              break;
-            } else if (nowChar == '\r') {
-              continue;
-            } else {
-              chunkSizeLine += nowChar;
+          size_t chunkSize = 0;
+          {
+            auto chunkSizeLine = co_await qabot::awaitable::withTimeout(
+                upstreamReader.readLine(), _timeouts.upstreamIdle);
+            auto [end, errc] = std::from_chars(
+                chunkSizeLine.data(),
+                chunkSizeLine.data() + chunkSizeLine.size(), chunkSize, 16);
+            if (errc != std::errc{}) {
+              throw std::runtime_error("Invalid chunk size from upstream");
             }
           }
-
-          co_await qabot::awaitable::Awaitable(
-              [clientSocketPtr, chunkSizeLine]() {
-                clientSocketPtr->send(chunkSizeLine + "\r\n");
-              });
-
-          if (chunkSizeLine == "0") {
-            co_await qabot::awaitable::Awaitable(
-                [sendingSocketPtr]() { sendingSocketPtr->receive(2); });
-            co_await qabot::awaitable::Awaitable(
-                [clientSocketPtr]() { clientSocketPtr->send("\r\n"); });
+          auto headerEnd = std::to_chars(chunkHeader,
+                                         chunkHeader + sizeof(chunkHeader) - 2,
+                                         chunkSize, 16)
+                               .ptr;
+          *headerEnd++ = '\r';
+          *headerEnd++ = '\n';
+          std::string_view chunkHeaderView(chunkHeader,
+                                           headerEnd - chunkHeader);
+
+          if (chunkSize == 0) {
+            // Trailer fields describe upstream's message, and the client
+            // never asked for trailers (TE: trailers), so they are dropped.
+            // Read up to the empty line that ends them, anything left over
+            // would cost us the pooled connection.
+            while (!(co_await qabot::awaitable::withTimeout(
+                         upstreamReader.readLine(), _timeouts.upstreamIdle))
+                        .empty()) {
+            }
+            std::array<std::string_view, 2> lastChunk{chunkHeaderView,
+                                                      "\r\n"};
+            co_await clientWriter.asyncWriteAll(lastChunk);
             break; // End of chunks
           }
-          // convert hex to int
-          int chunkSize = std::stoi(chunkSizeLine, nullptr, 16);
-          // read the chunk data
-          int totalBytesRead = 0;
-
-          std::string chunkData;
-
-          while (totalBytesRead < chunkSize) { // Read the chunk data
-            auto chunkFragment = co_await qabot::awaitable::Awaitable(
-                [sendingSocketPtr, byteToRead = chunkSize - totalBytesRead]() {
-                  return sendingSocketPtr->receive(byteToRead);
-                });
-            totalBytesRead += chunkFragment.size();
-            chunkData += chunkFragment;
-          }
-
-          // send the chunkData to client
-
-          co_await qabot::awaitable::Awaitable([clientSocketPtr, chunkData]() {
-            clientSocketPtr->send(chunkData + "\r\n");
-          });
-
-          responseBody += chunkData;
+          // the payload stays in the upstream read buffer, the client gets
+          // size line, payload and CRLF in a single gather write. Only what
+          // the client can't take right away is copied, and once too much
+          // piles up we stop reading from upstream until it drained.
+          auto chunkData = co_await qabot::awaitable::withTimeout(
+              upstreamReader.readExact(chunkSize), _timeouts.upstreamIdle);
+          std::array<std::string_view, 3> chunk{chunkHeaderView, chunkData,
+                                                "\r\n"};
+          co_await clientWriter.asyncWrite(chunk);
 
           // read the trailing CRLF
-          co_await qabot::awaitable::Awaitable(
-              [sendingSocketPtr]() { sendingSocketPtr->receive(2); });
+          co_await qabot::awaitable::withTimeout(upstreamReader.readExact(2),
+                                                 _timeouts.upstreamIdle);
         }
       } else {
-        // If not chunked, read the response body directly
-        auto body = co_await qabot::awaitable::Awaitable(
-            [sendingSocketPtr]() -> std::string {
-              return sendingSocketPtr->receive(1024 * 8);
-            });
+        // not an event stream, the client gets the whole body in one
+        // response. Every request has to be answered, or a pipelined one
+        // behind it would get this response.
+        std::pmr::string response(arena.allocator());
+        if (framing.contentLength) {
+          auto responseBody = co_await qabot::awaitable::withTimeout(
+              upstreamReader.readExact(*framing.contentLength),
+              _timeouts.upstreamIdle);
+          relayedResponseTemplate().render(response, {contentType, connection},
+                                           responseBody);
+        } else {
+          // the body ends when the server closes the connection
+          isReusable = false;
+          std::pmr::string responseBody(arena.allocator());
+          while (true) {
+            auto data = co_await qabot::awaitable::withTimeout(
+                upstreamReader.readSome(), _timeouts.upstreamIdle);
+            if (data.empty()) {
+              break;
+            }
+            responseBody += data;
+          }
+          relayedResponseTemplate().render(response, {contentType, connection},
+                                           responseBody);
+        }
+        isResponseStarted = true;
+        co_await clientWriter.asyncWriteAll(response);
+      }
 
-        responseBody = body;
+      if (isReusable) {
+        UpstreamPool::getInstance().release(std::move(upstream));
+      }
+      if (!isKeepAlive) {
+        break;
       }
     }
   } catch (const qabot::socket::SocketException &e) {
@@ -300,7 +474,7 @@ Server::_clientLoop(qabot::socket::Socket<SocketImpl> &&clientSocket) {
     errorStream << "\r\n";
     errorStream << "Error: " << e.what() << "\r\n";
 
-    clientSocketPtr->send(errorStream.str());
+    errorResponse = errorStream.str();
   } catch (const std::exception &e) {
     std::cerr << "Error: " << e.what() << std::endl;
     std::stringstream errorStream;
@@ -310,7 +484,19 @@ Server::_clientLoop(qabot::socket::Socket<SocketImpl> &&clientSocket) {
     errorStream << "\r\n";
     errorStream << "Error: " << e.what() << "\r\n";
 
-    clientSocketPtr->send(errorStream.str());
+    errorResponse = errorStream.str();
+  }
+
+  // Once a response is under way, e.g. an SSE stream whose upstream went idle,
+  // an error response would land in the middle of it. The connection is
+  // closed instead, a chunked stream without its last chunk tells the client
+  // the response is incomplete.
+  if (!errorResponse.empty() && !isResponseStarted) {
+    try {
+      co_await clientWriter.asyncWriteAll(errorResponse);
+    } catch (const std::exception &e) {
+      std::cerr << "Error sending error response: " << e.what() << std::endl;
+    }
   }
 }
 } // namespace qabot::server
\ No newline at end of file
@@ -3,6 +3,28 @@
 
 using namespace qabot::socket;
 
+namespace {
+// Translate the errno of a failed datagram call, those still report errors by
+// throwing. EAGAIN becomes the would-block IoErrc.
+std::system_error socketError(int error, IoErrc wouldBlock,
+                              const std::string &message) {
+  if (error == EAGAIN || error == EWOULDBLOCK) {
+    return std::system_error(make_error_code(wouldBlock), message);
+  }
+  return std::system_error(error, std::generic_category(), message);
+}
+
+// For the calls that return an IoResult: EAGAIN is returned as the
+// readiness to wait for, only a real error is thrown
+std::unexpected<IoErrc> wouldBlockOrThrow(int error, IoErrc wouldBlock,
+                                          const char *message) {
+  if (error == EAGAIN || error == EWOULDBLOCK) {
+    return std::unexpected(wouldBlock);
+  }
+  throw std::system_error(error, std::generic_category(), message);
+}
+} // namespace
+
 UnixSocketImpl::UnixSocketImpl(TransportProtocol protocol, IPVersion ipVersion)
     : _protocol(protocol), _ipVersion(ipVersion) {
   // Initialize socket
@@ -49,44 +71,103 @@ UnixSocketImpl &UnixSocketImpl::operator=(UnixSocketImpl &&other) {
   return *this;
 }
 
-void UnixSocketImpl::connect(const std::string &serverName, const int port) {
+IoResult<void> UnixSocketImpl::connect(const std::string &serverName,
+                                       const int port) {
   addrinfo *addrInfo;
-  getaddrinfo(serverName.c_str(), std::to_string(port).c_str(), nullptr,
-              &addrInfo);
+  if (auto result = getaddrinfo(serverName.c_str(),
+                                std::to_string(port).c_str(), nullptr,
+                                &addrInfo);
+      result != 0) {
+    throw std::runtime_error("Failed to get address info for " + serverName +
+                             ": " + gai_strerror(result));
+  }
   if (_protocol == TransportProtocol::UDP) {
     std::cerr << "Warning: UDP does not support connect()" << std::endl;
-    return;
+    return {};
   }
 
-  int connectResult;
+  int connectResult = -1;
+
+  int connectError = 0;
 
   for (addrinfo *p = addrInfo; p != nullptr; p = p->ai_next) {
     connectResult = ::connect(_socket, p->ai_addr, p->ai_addrlen);
+    connectError = errno;
     if (connectResult == 0) {
       std::cout << "Successfully connected to " << serverName << " ("
                 << inet_ntoa(((sockaddr_in *)p->ai_addr)->sin_addr)
                 << ") on port " << port << std::endl;
       break; // Success
     }
+    if (connectError == EINPROGRESS || connectError == EALREADY ||
+        connectError == EISCONN) {
+      // the handshake for this address is already under way
+      break;
+    }
   }
+  freeaddrinfo(addrInfo);
 
   if (connectResult != 0) {
-    if (errno == EISCONN) {
+    if (connectError == EISCONN) {
+    } else if (connectError == EINPROGRESS || connectError == EALREADY) {
+      // wait until the socket becomes writable and call connect again
+      return std::unexpected(IoErrc::WantWrite);
     } else {
-      throw std::system_error(errno, std::generic_category(),
+      throw std::system_error(connectError, std::generic_category(),
                               "Failed to connect to server: " + serverName +
                                   ":" + std::to_string(port));
     }
   }
-  freeaddrinfo(addrInfo);
+  return {};
+}
+
+IoResult<void> UnixSocketImpl::connect(const Endpoint &endpoint) {
+  if (::connect(_socket, reinterpret_cast<const sockaddr *>(&endpoint.address),
+                endpoint.length) == 0) {
+    return {};
+  }
+
+  const int connectError = errno;
+  if (connectError == EISCONN) {
+    return {};
+  }
+  if (connectError == EINPROGRESS || connectError == EALREADY) {
+    // wait until the socket becomes writable and call connect again
+    return std::unexpected(IoErrc::WantWrite);
+  }
+  throw std::system_error(connectError, std::generic_category(),
+                          "Failed to connect to " + endpoint.toString());
+}
+
+IoResult<size_t> UnixSocketImpl::send(const std::string &message) {
+  ssize_t bytesSent =
+      ::send(_socket, message.c_str(), message.size(), MSG_NOSIGNAL);
+  if (bytesSent < 0) {
+    return wouldBlockOrThrow(errno, IoErrc::WantWrite,
+                             "Failed to send message");
+  }
+  return static_cast<size_t>(bytesSent);
 }
 
-void UnixSocketImpl::send(const std::string &message) {
-  ssize_t bytesSent = ::send(_socket, message.c_str(), message.size(), 0);
+IoResult<size_t>
+UnixSocketImpl::sendv(std::span<const std::string_view> buffers) {
+  constexpr size_t kMaxBuffers = 16;
+  iovec iovecs[kMaxBuffers];
+  size_t count = std::min(buffers.size(), kMaxBuffers);
+  for (size_t i = 0; i < count; ++i) {
+    iovecs[i].iov_base = const_cast<char *>(buffers[i].data());
+    iovecs[i].iov_len = buffers[i].size();
+  }
+
+  msghdr message{};
+  message.msg_iov = iovecs;
+  message.msg_iovlen = count;
+  ssize_t bytesSent = ::sendmsg(_socket, &message, MSG_NOSIGNAL);
   if (bytesSent < 0) {
-    throw std::system_error(errno, std::generic_category(),
-                            "Failed to send message");
+    return wouldBlockOrThrow(errno, IoErrc::WantWrite,
+                             "Failed to send message");
   }
+  return static_cast<size_t>(bytesSent);
 }
 
 void UnixSocketImpl::sendTo(const std::string &serverName, const int port,
@@ -106,9 +187,9 @@ void UnixSocketImpl::sendTo(const std::string &serverName, const int port,
     }
   }
   if (bytesSent < 0) {
-    throw std::system_error(errno, std::generic_category(),
-                            "Failed to send message to " + serverName + ":" +
-                                std::to_string(port));
+    throw socketError(errno, IoErrc::WantWrite,
+                      "Failed to send message to " + serverName + ":" +
+                          std::to_string(port));
   }
   if (bytesSent != message.size()) {
     std::cerr << "Warning: Not all bytes sent" << std::endl;
@@ -145,8 +226,7 @@ UnixSocketImpl::receiveFrom(size_t bufferSize) {
   ssize_t bytesReceived = ::recvfrom(_socket, buffer.data(), bufferSize, 0,
                                      (sockaddr *)&addrStorage, &addrLen);
   if (bytesReceived < 0) {
-    throw std::system_error(errno, std::generic_category(),
-                            "Failed to receive message");
+    throw socketError(errno, IoErrc::WantRead, "Failed to receive message");
   }
 
   std::string message(buffer.data(), bytesReceived);
@@ -173,25 +253,46 @@ UnixSocketImpl::receiveFrom(size_t bufferSize) {
   return {message, clientInfo};
 }
 
-std::string UnixSocketImpl::receive(size_t bufferSize) {
-  std::vector<char> buffer(bufferSize);
+IoResult<std::string> UnixSocketImpl::receive(size_t bufferSize) {
+  // receive straight into the string, bufferSize is only an upper bound and
+  // shouldn't cost a zeroed allocation plus a copy
+  std::string message;
+  ssize_t bytesReceived = 0;
+  message.resize_and_overwrite(bufferSize, [&](char *data, size_t size) {
+    bytesReceived = ::recv(_socket, data, size, 0);
+    return bytesReceived < 0 ? 0 : static_cast<size_t>(bytesReceived);
+  });
+  if (bytesReceived < 0) {
+    return wouldBlockOrThrow(errno, IoErrc::WantRead,
+                             "Failed to receive message");
+  }
 
-  ssize_t bytesReceived = ::recv(_socket, buffer.data(), bufferSize, 0);
+  return message;
+}
+
+IoResult<size_t> UnixSocketImpl::receiveSome(char *data, size_t size) {
+  ssize_t bytesReceived = ::recv(_socket, data, size, 0);
   if (bytesReceived < 0) {
-    throw std::system_error(errno, std::generic_category(),
-                            "Failed to receive message");
+    return wouldBlockOrThrow(errno, IoErrc::WantRead,
+                             "Failed to receive message");
   }
 
-  return std::string(buffer.data(), bytesReceived);
+  return static_cast<size_t>(bytesReceived);
 }
 
-UnixSocketImpl UnixSocketImpl::accept() {
+IoResult<UnixSocketImpl> UnixSocketImpl::accept() {
   sockaddr_storage addrStorage;
   socklen_t addrLen = sizeof(addrStorage);
+#ifdef __linux__
+  // non-blocking from the start, init() has nothing left to change
+  int clientSocket = ::accept4(_socket, (sockaddr *)&addrStorage, &addrLen,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
   int clientSocket = ::accept(_socket, (sockaddr *)&addrStorage, &addrLen);
+#endif
   if (clientSocket < 0) {
-    throw std::system_error(errno, std::generic_category(),
-                            "Failed to accept connection");
+    return wouldBlockOrThrow(errno, IoErrc::WantRead,
+                             "Failed to accept connection");
   }
   ClientInfo clientInfo;
   char clientIpStr[INET6_ADDRSTRLEN];
@@ -226,10 +327,21 @@ void UnixSocketImpl::listen(int backlog) {
 void UnixSocketImpl::close() {
   if (_socket >= 0) {
     shutdown(_socket, SHUT_RDWR);
+    ::close(_socket);
     _socket = -1;
   }
 }
 
+bool UnixSocketImpl::setReusePort() {
+#ifdef SO_REUSEPORT
+  int enable = 1;
+  return setsockopt(_socket, SOL_SOCKET, SO_REUSEPORT, &enable,
+                    sizeof(enable)) == 0;
+#else
+  return false;
+#endif
+}
+
 bool UnixSocketImpl::init() {
   const int flags = fcntl(_socket, F_GETFL, 0);
   if (flags == -1) {
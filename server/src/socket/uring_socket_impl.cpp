@@ -0,0 +1,421 @@
+#ifdef QABOT_IO_URING
+#include "socket/uring_socket_impl.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include "reactor/reactor.hpp"
+#include "uring/uring.hpp"
+
+using namespace qabot::socket;
+
+namespace {
+// staged data before send reports would-block
+constexpr size_t kMaxQueuedBytes = 256 * 1024;
+
+// provided buffers a socket holds on to before its multishot receive stops,
+// they are shared by every socket and only go back to the kernel once read
+constexpr size_t kMaxHeldBuffers = 8;
+
+// a send that makes no progress for this long fails the socket
+constexpr auto kSendTimeout = std::chrono::seconds(60);
+}  // namespace
+
+struct UringSocketImpl::State {
+  explicit State(int fd) : fd(fd) {
+    receiveOperation = {&State::_onReceive, this};
+    acceptOperation = {&State::_onAccept, this};
+    sendOperation = {&State::_onSend, this};
+    sendTimeout.tv_sec = kSendTimeout.count();
+  }
+
+  int fd;
+  std::mutex mutex;
+  // operations submitted whose last completion hasn't arrived yet
+  int pendingOperations = 0;
+  bool isClosed = false;
+
+  qabot::uring::Operation receiveOperation;
+  bool isReceiving = false;
+  bool isReceiveCancelled = false;
+  // a provided buffer the kernel filled, handed back once it was read
+  struct ReceivedBuffer {
+    uint16_t id;
+    uint32_t size;
+    uint32_t readPos = 0;
+  };
+  // the unread ones start at receivedPos
+  std::vector<ReceivedBuffer> received;
+  size_t receivedPos = 0;
+  bool isEndOfStream = false;
+  int receiveError = 0;
+
+  qabot::uring::Operation acceptOperation;
+  bool isAccepting = false;
+  std::deque<int> accepted;
+  int acceptError = 0;
+
+  qabot::uring::Operation sendOperation;
+  // filled by send while the previous batch is in flight
+  std::string staged;
+  std::string sending;
+  size_t sentBytes = 0;
+  bool isSending = false;
+  int sendError = 0;
+  __kernel_timespec sendTimeout{};
+
+  // the methods below need mutex held
+  void armReceive() {
+    io_uring_sqe entry{};
+    entry.opcode = IORING_OP_RECV;
+    entry.fd = fd;
+    entry.ioprio = IORING_RECV_MULTISHOT;
+    entry.flags = IOSQE_BUFFER_SELECT;
+    entry.buf_group = qabot::uring::Uring::kBufferGroup;
+    entry.user_data = reinterpret_cast<uint64_t>(&receiveOperation);
+    qabot::uring::Uring::getInstance().submit({entry});
+    ++pendingOperations;
+    isReceiving = true;
+    isReceiveCancelled = false;
+  }
+
+  void armAccept() {
+    io_uring_sqe entry{};
+    entry.opcode = IORING_OP_ACCEPT;
+    entry.fd = fd;
+    entry.ioprio = IORING_ACCEPT_MULTISHOT;
+    entry.accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    entry.user_data = reinterpret_cast<uint64_t>(&acceptOperation);
+    qabot::uring::Uring::getInstance().submit({entry});
+    ++pendingOperations;
+    isAccepting = true;
+  }
+
+  // send what is left of sending, linked to a timeout
+  void submitSend() {
+    io_uring_sqe entry{};
+    entry.opcode = IORING_OP_SEND;
+    entry.fd = fd;
+    entry.addr = reinterpret_cast<uint64_t>(sending.data() + sentBytes);
+    entry.len = static_cast<uint32_t>(sending.size() - sentBytes);
+    entry.msg_flags = MSG_NOSIGNAL;
+    entry.flags = IOSQE_IO_LINK;
+    entry.user_data = reinterpret_cast<uint64_t>(&sendOperation);
+
+    io_uring_sqe timeout{};
+    timeout.opcode = IORING_OP_LINK_TIMEOUT;
+    timeout.addr = reinterpret_cast<uint64_t>(&sendTimeout);
+    timeout.len = 1;
+
+    qabot::uring::Uring::getInstance().submit({entry, timeout});
+    ++pendingOperations;
+    isSending = true;
+  }
+
+  // the staged data becomes the next batch
+  void startSend() {
+    sending.swap(staged);
+    staged.clear();
+    sentBytes = 0;
+    submitSend();
+  }
+
+  void cancel(const qabot::uring::Operation& operation) {
+    io_uring_sqe entry{};
+    entry.opcode = IORING_OP_ASYNC_CANCEL;
+    entry.addr = reinterpret_cast<uint64_t>(&operation);
+    qabot::uring::Uring::getInstance().submit({entry});
+  }
+
+  // with mutex released, wakes interest unless the socket is closed and
+  // frees the state after the last completion
+  static void finishCompletion(State& state, bool isClosed, bool isDone,
+                               int fd, qabot::reactor::Interest interest) {
+    if (!isClosed) {
+      qabot::reactor::Reactor::getInstance().notify(fd, interest);
+    }
+    if (isDone) {
+      destroy(&state);
+    }
+  }
+
+  // give the buffers nobody read back to the kernel
+  void recycleReceived() {
+    for (auto i = receivedPos; i < received.size(); ++i) {
+      qabot::uring::Uring::getInstance().recycle(received[i].id);
+    }
+    received.clear();
+    receivedPos = 0;
+  }
+
+  static void destroy(State* state) {
+    // the handle number is reused once it's closed
+    qabot::reactor::Reactor::getInstance().setNotifyOnly(state->fd, false);
+    ::shutdown(state->fd, SHUT_RDWR);
+    ::close(state->fd);
+    delete state;
+  }
+
+ private:
+  static void _onReceive(void* context, int result, uint32_t flags) {
+    auto& state = *static_cast<State*>(context);
+    // the state may be gone once the mutex is released
+    const int fd = state.fd;
+    auto& uring = qabot::uring::Uring::getInstance();
+    bool isClosed, isDone;
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      if (result > 0 && (flags & IORING_CQE_F_BUFFER)) {
+        auto id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (state.isClosed) {
+          uring.recycle(id);
+        } else {
+          state.received.push_back({id, static_cast<uint32_t>(result)});
+        }
+      } else if (result == 0) {
+        state.isEndOfStream = true;
+      } else if (result < 0 && result != -ENOBUFS && result != -ECANCELED) {
+        state.receiveError = -result;
+      }
+
+      if (!(flags & IORING_CQE_F_MORE)) {
+        // the receive ended, the next receiveSome that finds nothing
+        // queued arms it again
+        state.isReceiving = false;
+        --state.pendingOperations;
+      } else if (state.received.size() - state.receivedPos >=
+                     kMaxHeldBuffers &&
+                 !state.isReceiveCancelled) {
+        // nobody is reading, stop taking buffers until the queue drained
+        state.isReceiveCancelled = true;
+        state.cancel(state.receiveOperation);
+      }
+      isClosed = state.isClosed;
+      isDone = isClosed && state.pendingOperations == 0;
+    }
+    finishCompletion(state, isClosed, isDone, fd,
+                     qabot::reactor::Interest::Read);
+  }
+
+  static void _onAccept(void* context, int result, uint32_t flags) {
+    auto& state = *static_cast<State*>(context);
+    // the state may be gone once the mutex is released
+    const int fd = state.fd;
+    bool isClosed, isDone;
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      if (result >= 0) {
+        if (state.isClosed) {
+          ::close(result);
+        } else {
+          state.accepted.push_back(result);
+        }
+      } else if (result != -ECANCELED) {
+        state.acceptError = -result;
+      }
+
+      if (!(flags & IORING_CQE_F_MORE)) {
+        state.isAccepting = false;
+        --state.pendingOperations;
+      }
+      isClosed = state.isClosed;
+      isDone = isClosed && state.pendingOperations == 0;
+    }
+    finishCompletion(state, isClosed, isDone, fd,
+                     qabot::reactor::Interest::Read);
+  }
+
+  static void _onSend(void* context, int result, uint32_t) {
+    auto& state = *static_cast<State*>(context);
+    // the state may be gone once the mutex is released
+    const int fd = state.fd;
+    bool isClosed, isDone;
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      --state.pendingOperations;
+      state.isSending = false;
+      if (result < 0) {
+        // a send cancelled by its linked timeout made no progress for
+        // kSendTimeout
+        state.sendError = result == -ECANCELED ? ETIMEDOUT : -result;
+        state.staged.clear();
+      } else {
+        state.sentBytes += result;
+        if (state.sentBytes < state.sending.size()) {
+          state.submitSend();
+        } else if (!state.staged.empty()) {
+          state.startSend();
+        }
+      }
+      isClosed = state.isClosed;
+      isDone = isClosed && state.pendingOperations == 0;
+    }
+    finishCompletion(state, isClosed, isDone, fd,
+                     qabot::reactor::Interest::Write);
+  }
+};
+
+UringSocketImpl::State* UringSocketImpl::_uring() {
+  if (!_state && _socket.getSocketFD() >= 0 &&
+      qabot::uring::Uring::getInstance().isAvailable()) {
+    _state = new State(_socket.getSocketFD());
+    // completions wake the socket's coroutines from now on
+    qabot::reactor::Reactor::getInstance().setNotifyOnly(_state->fd, true);
+  }
+  return _state;
+}
+
+IoResult<size_t> UringSocketImpl::send(const std::string& message) {
+  std::string_view buffer(message);
+  return sendv({&buffer, 1});
+}
+
+IoResult<size_t> UringSocketImpl::sendv(
+    std::span<const std::string_view> buffers) {
+  auto* state = _uring();
+  if (!state) {
+    return _socket.sendv(buffers);
+  }
+
+  std::lock_guard<std::mutex> lock(state->mutex);
+  if (state->sendError) {
+    throw std::system_error(state->sendError, std::generic_category(),
+                            "Failed to send message");
+  }
+  if (state->staged.size() >= kMaxQueuedBytes) {
+    // the completion of the batch in flight wakes us up
+    return std::unexpected(IoErrc::WantWrite);
+  }
+
+  size_t taken = 0;
+  for (auto buffer : buffers) {
+    auto size = std::min(buffer.size(), kMaxQueuedBytes - state->staged.size());
+    state->staged.append(buffer.substr(0, size));
+    taken += size;
+    if (size < buffer.size()) {
+      break;
+    }
+  }
+  if (!state->isSending && !state->staged.empty()) {
+    state->startSend();
+  }
+  return taken;
+}
+
+IoResult<std::string> UringSocketImpl::receive(size_t bufferSize) {
+  std::string message(bufferSize, '\0');
+  auto received = receiveSome(message.data(), bufferSize);
+  if (!received) {
+    return std::unexpected(received.error());
+  }
+  message.resize(*received);
+  return message;
+}
+
+IoResult<size_t> UringSocketImpl::receiveSome(char* data, size_t size) {
+  auto* state = _uring();
+  if (!state) {
+    return _socket.receiveSome(data, size);
+  }
+
+  std::lock_guard<std::mutex> lock(state->mutex);
+  if (state->receivedPos < state->received.size()) {
+    // straight from the provided buffers, each goes back to the kernel as
+    // soon as it was read
+    auto& uring = qabot::uring::Uring::getInstance();
+    size_t copied = 0;
+    while (copied < size && state->receivedPos < state->received.size()) {
+      auto& buffer = state->received[state->receivedPos];
+      auto unread = uring.buffer(buffer.id, buffer.size).substr(buffer.readPos);
+      auto bytes = std::min(size - copied, unread.size());
+      std::memcpy(data + copied, unread.data(), bytes);
+      copied += bytes;
+      buffer.readPos += bytes;
+      if (buffer.readPos == buffer.size) {
+        uring.recycle(buffer.id);
+        ++state->receivedPos;
+      }
+    }
+    if (state->receivedPos == state->received.size()) {
+      state->received.clear();
+      state->receivedPos = 0;
+    }
+    return copied;
+  }
+  if (state->isEndOfStream) {
+    return 0;
+  }
+  if (state->receiveError) {
+    throw std::system_error(state->receiveError, std::generic_category(),
+                            "Failed to receive message");
+  }
+  if (!state->isReceiving) {
+    state->armReceive();
+  }
+  return std::unexpected(IoErrc::WantRead);
+}
+
+IoResult<UringSocketImpl> UringSocketImpl::accept() {
+  auto* state = _uring();
+  if (!state) {
+    auto clientSocket = _socket.accept();
+    if (!clientSocket) {
+      return std::unexpected(clientSocket.error());
+    }
+    return UringSocketImpl(std::move(*clientSocket));
+  }
+
+  std::lock_guard<std::mutex> lock(state->mutex);
+  if (!state->accepted.empty()) {
+    auto clientSocket = state->accepted.front();
+    state->accepted.pop_front();
+    return UringSocketImpl(UnixSocketImpl(clientSocket, getProtocol(),
+                                          getIPVersion()));
+  }
+  if (auto error = std::exchange(state->acceptError, 0)) {
+    throw std::system_error(error, std::generic_category(),
+                            "Failed to accept connection");
+  }
+  if (!state->isAccepting) {
+    state->armAccept();
+  }
+  return std::unexpected(IoErrc::WantRead);
+}
+
+void UringSocketImpl::close() {
+  auto* state = std::exchange(_state, nullptr);
+  if (!state) {
+    _socket.close();
+    return;
+  }
+
+  // from here on the handle belongs to the state
+  _socket.release();
+  bool isDone = false;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->isClosed = true;
+    if (state->isReceiving) {
+      state->cancel(state->receiveOperation);
+    }
+    if (state->isAccepting) {
+      state->cancel(state->acceptOperation);
+    }
+    state->recycleReceived();
+    for (auto clientSocket : state->accepted) {
+      ::close(clientSocket);
+    }
+    state->accepted.clear();
+    isDone = state->pendingOperations == 0;
+  }
+  if (isDone) {
+    State::destroy(state);
+  }
+}
+#endif  // QABOT_IO_URING
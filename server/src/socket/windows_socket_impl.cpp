@@ -2,6 +2,28 @@
 #include "socket/windows_socket_impl.hpp"
 
 namespace qabot::socket {
+namespace {
+// Translate a WSA error of a failed datagram call, those still report errors
+// by throwing. WSAEWOULDBLOCK becomes the would-block IoErrc.
+std::system_error socketError(int error, IoErrc wouldBlock,
+                              const std::string &message) {
+  if (error == WSAEWOULDBLOCK) {
+    return std::system_error(make_error_code(wouldBlock), message);
+  }
+  return std::system_error(error, std::generic_category(), message);
+}
+
+// For the calls that return an IoResult: WSAEWOULDBLOCK is returned as the
+// readiness to wait for, only a real error is thrown
+std::unexpected<IoErrc> wouldBlockOrThrow(int error, IoErrc wouldBlock,
+                                          const char *message) {
+  if (error == WSAEWOULDBLOCK) {
+    return std::unexpected(wouldBlock);
+  }
+  throw std::system_error(error, std::generic_category(), message);
+}
+} // namespace
+
 std::mutex WindowsSocketImpl::_socketMutex;
 int WindowsSocketImpl::_activeSocketInstance = 0;
 
@@ -65,7 +87,8 @@ bool WindowsSocketImpl::init() {
   return true;
 }
 
-void WindowsSocketImpl::connect(const std::string &serverName, const int port) {
+IoResult<void> WindowsSocketImpl::connect(const std::string &serverName,
+                                          const int port) {
   addrinfo *addrInfo;
   auto result = getaddrinfo(serverName.c_str(), std::to_string(port).c_str(),
                             nullptr, &addrInfo);
@@ -81,7 +104,7 @@ void WindowsSocketImpl::connect(const std::string &serverName, const int port) {
 
   if (_protocol == TransportProtocol::UDP) {
     std::cerr << "Warning: UDP does not support connect()" << std::endl;
-    return;
+    return {};
   }
   int connectResult;
 
@@ -95,8 +118,14 @@ void WindowsSocketImpl::connect(const std::string &serverName, const int port) {
     }
   }
   if (connectResult != 0) {
-    if (WSAGetLastError() == WSAEISCONN) {
-      
+    const int connectError = WSAGetLastError();
+    if (connectError == WSAEISCONN) {
+
+    } else if (connectError == WSAEWOULDBLOCK || connectError == WSAEALREADY ||
+               connectError == WSAEINVAL) {
+      freeaddrinfo(addrInfo);
+      // wait until the socket becomes writable and call connect again
+      return std::unexpected(IoErrc::WantWrite);
     } else {
       throw std::system_error(WSAGetLastError(), std::generic_category(),
                               "Failed to connect to server: " + serverName +
@@ -104,15 +133,54 @@ void WindowsSocketImpl::connect(const std::string &serverName, const int port) {
     }
   }
   freeaddrinfo(addrInfo);
+  return {};
 }
 
-void WindowsSocketImpl::send(const std::string &message) {
+IoResult<void> WindowsSocketImpl::connect(const Endpoint &endpoint) {
+  if (::connect(_socket, reinterpret_cast<const sockaddr *>(&endpoint.address),
+                endpoint.length) == 0) {
+    return {};
+  }
+
+  const int connectError = WSAGetLastError();
+  if (connectError == WSAEISCONN) {
+    return {};
+  }
+  if (connectError == WSAEWOULDBLOCK || connectError == WSAEALREADY ||
+      connectError == WSAEINVAL) {
+    // wait until the socket becomes writable and call connect again
+    return std::unexpected(IoErrc::WantWrite);
+  }
+  throw std::system_error(connectError, std::generic_category(),
+                          "Failed to connect to " + endpoint.toString());
+}
+
+IoResult<size_t> WindowsSocketImpl::send(const std::string &message) {
   int bytesSent = ::send(_socket, message.c_str(), message.size(), 0);
   if (bytesSent == SOCKET_ERROR) {
-    std::cerr << "Send error: " << WSAGetLastError() << std::endl;
-    throw std::system_error(WSAGetLastError(), std::generic_category(),
-                            "Failed to send message");
+    return wouldBlockOrThrow(WSAGetLastError(), IoErrc::WantWrite,
+                             "Failed to send message");
   }
+  return static_cast<size_t>(bytesSent);
+}
+
+IoResult<size_t>
+WindowsSocketImpl::sendv(std::span<const std::string_view> buffers) {
+  constexpr size_t kMaxBuffers = 16;
+  WSABUF wsaBuffers[kMaxBuffers];
+  size_t count = std::min(buffers.size(), kMaxBuffers);
+  for (size_t i = 0; i < count; ++i) {
+    wsaBuffers[i].buf = const_cast<char *>(buffers[i].data());
+    wsaBuffers[i].len = static_cast<ULONG>(buffers[i].size());
+  }
+
+  DWORD bytesSent = 0;
+  if (WSASend(_socket, wsaBuffers, static_cast<DWORD>(count), &bytesSent, 0,
+              nullptr, nullptr) == SOCKET_ERROR) {
+    return wouldBlockOrThrow(WSAGetLastError(), IoErrc::WantWrite,
+                             "Failed to send message");
+  }
+  return static_cast<size_t>(bytesSent);
 }
 
 void WindowsSocketImpl::sendTo(const std::string &serverName, const int port,
@@ -162,16 +230,32 @@ void WindowsSocketImpl::bind(const std::string &serverName, const int port) {
   freeaddrinfo(addrInfo);
 }
 
-std::string WindowsSocketImpl::receive(size_t bufferSize) {
-  std::vector<char> buffer(bufferSize);
+IoResult<std::string> WindowsSocketImpl::receive(size_t bufferSize) {
+  // receive straight into the string, bufferSize is only an upper bound and
+  // shouldn't cost a zeroed allocation plus a copy
+  std::string message;
+  int bytesReceived = 0;
+  message.resize_and_overwrite(bufferSize, [&](char *data, size_t size) {
+    bytesReceived = ::recv(_socket, data, static_cast<int>(size), 0);
+    return bytesReceived == SOCKET_ERROR ? 0
+                                         : static_cast<size_t>(bytesReceived);
+  });
+  if (bytesReceived == SOCKET_ERROR) {
+    return wouldBlockOrThrow(WSAGetLastError(), IoErrc::WantRead,
+                             "Failed to receive message");
+  }
+
+  return message;
+}
 
-  int bytesReceived = ::recv(_socket, buffer.data(), bufferSize, 0);
+IoResult<size_t> WindowsSocketImpl::receiveSome(char *data, size_t size) {
+  int bytesReceived = ::recv(_socket, data, static_cast<int>(size), 0);
   if (bytesReceived == SOCKET_ERROR) {
-    throw std::system_error(WSAGetLastError(), std::generic_category(),
-                            "Failed to receive message");
+    return wouldBlockOrThrow(WSAGetLastError(), IoErrc::WantRead,
+                             "Failed to receive message");
   }
 
-  return std::string(buffer.data(), bytesReceived);
+  return static_cast<size_t>(bytesReceived);
 }
 
 std::pair<std::string, ClientInfo>
@@ -182,8 +266,8 @@ WindowsSocketImpl::receiveFrom(size_t bufferSize) {
   int bytesReceived = ::recvfrom(_socket, buffer.data(), bufferSize, 0,
                                  (sockaddr *)&addrStorage, &addrLen);
   if (bytesReceived == SOCKET_ERROR) {
-    throw std::system_error(WSAGetLastError(), std::generic_category(),
-                            "Failed to receive message");
+    throw socketError(WSAGetLastError(), IoErrc::WantRead,
+                      "Failed to receive message");
   }
 
   ClientInfo clientInfo;
@@ -208,13 +292,13 @@ WindowsSocketImpl::receiveFrom(size_t bufferSize) {
   return {std::string(buffer.data(), bytesReceived), clientInfo};
 }
 
-WindowsSocketImpl WindowsSocketImpl::accept() {
+IoResult<WindowsSocketImpl> WindowsSocketImpl::accept() {
   sockaddr_storage addrStorage;
   socklen_t addrLen = sizeof(addrStorage);
   SOCKET clientSocket = ::accept(_socket, (sockaddr *)&addrStorage, &addrLen);
   if (clientSocket == INVALID_SOCKET) {
-    throw std::system_error(WSAGetLastError(), std::generic_category(),
-                            "Failed to accept connection");
+    return wouldBlockOrThrow(WSAGetLastError(), IoErrc::WantRead,
+                             "Failed to accept connection");
   }
 
   ClientInfo clientInfo;
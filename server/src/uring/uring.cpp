@@ -0,0 +1,249 @@
+#ifdef QABOT_IO_URING
+#include "uring/uring.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <system_error>
+
+namespace qabot::uring {
+namespace {
+// the kernel's ring indices are shared memory, read and written with
+// acquire and release like liburing does
+unsigned loadAcquire(unsigned *pointer) {
+  return std::atomic_ref<unsigned>(*pointer).load(std::memory_order_acquire);
+}
+void storeRelease(unsigned *pointer, unsigned value) {
+  std::atomic_ref<unsigned>(*pointer).store(value, std::memory_order_release);
+}
+
+int enter(int ringFd, unsigned toSubmit, unsigned minComplete,
+          unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit,
+                                  minComplete, flags, nullptr, 0));
+}
+
+// neighbouring provided buffers are handed over with one entry
+io_uring_sqe provideBuffers(char *buffers, uint16_t firstId, size_t count) {
+  io_uring_sqe entry{};
+  entry.opcode = IORING_OP_PROVIDE_BUFFERS;
+  entry.fd = static_cast<int>(count);
+  entry.addr = reinterpret_cast<uint64_t>(buffers +
+                                          size_t{firstId} * Uring::kBufferSize);
+  entry.len = Uring::kBufferSize;
+  entry.off = firstId;
+  entry.buf_group = Uring::kBufferGroup;
+  return entry;
+}
+
+void *mapRing(int ringFd, size_t size, off_t offset) {
+  auto *address = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ringFd, offset);
+  if (address == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Failed to map io_uring");
+  }
+  return address;
+}
+} // namespace
+
+Uring::Uring() {
+  if (!_isEnabled) {
+    return;
+  }
+  try {
+    _setUp();
+    _setUpBuffers();
+  } catch (const std::exception &e) {
+    std::cerr << "io_uring unavailable, using non-blocking sockets: "
+              << e.what() << std::endl;
+    _tearDown();
+    return;
+  }
+  _completionThread = std::thread([this] { _completionLoop(); });
+}
+
+Uring::~Uring() {
+  if (!isAvailable()) {
+    return;
+  }
+  _isRunning = false;
+  // a no-op completion wakes the completion thread up
+  io_uring_sqe nop{};
+  nop.opcode = IORING_OP_NOP;
+  submit({nop});
+  if (_completionThread.joinable()) {
+    _completionThread.join();
+  }
+  _tearDown();
+}
+
+void Uring::_setUp() {
+  io_uring_params params{};
+  // multishot operations complete a lot more often than they are submitted
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = kEntries * 8;
+  _ringFd = static_cast<int>(syscall(__NR_io_uring_setup, kEntries, &params));
+  if (_ringFd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "io_uring_setup failed");
+  }
+
+  _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+  }
+  _sqRing = mapRing(_ringFd, _sqRingSize, IORING_OFF_SQ_RING);
+  _cqRing = params.features & IORING_FEAT_SINGLE_MMAP
+                ? _sqRing
+                : mapRing(_ringFd, _cqRingSize, IORING_OFF_CQ_RING);
+  _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  _sqes = static_cast<io_uring_sqe *>(
+      mapRing(_ringFd, _sqesSize, IORING_OFF_SQES));
+
+  auto *sq = static_cast<char *>(_sqRing);
+  _sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  _sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  _sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  _sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+  auto *cq = static_cast<char *>(_cqRing);
+  _cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  _cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  _cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  _cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+void Uring::_setUpBuffers() {
+  auto *buffers = mmap(nullptr, kBufferCount * kBufferSize,
+                       PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                       -1, 0);
+  if (buffers == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Failed to allocate provided buffers");
+  }
+  _buffers = static_cast<char *>(buffers);
+  _recycled.reserve(kBufferCount);
+  _providing.reserve(kBufferCount);
+
+  // the completion thread isn't running yet, wait for the answer here
+  auto entry = provideBuffers(_buffers, 0, kBufferCount);
+  _submit(&entry, 1);
+  if (enter(_ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "io_uring_enter failed");
+  }
+  auto head = *_cqHead;
+  auto result = _cqes[head & _cqMask].res;
+  storeRelease(_cqHead, head + 1);
+  if (result < 0) {
+    throw std::system_error(-result, std::generic_category(),
+                            "Failed to provide buffers");
+  }
+}
+
+void Uring::_tearDown() {
+  if (_buffers) {
+    munmap(_buffers, kBufferCount * kBufferSize);
+    _buffers = nullptr;
+  }
+  if (_sqes) {
+    munmap(_sqes, _sqesSize);
+    _sqes = nullptr;
+  }
+  if (_cqRing && _cqRing != _sqRing) {
+    munmap(_cqRing, _cqRingSize);
+  }
+  _cqRing = nullptr;
+  if (_sqRing) {
+    munmap(_sqRing, _sqRingSize);
+    _sqRing = nullptr;
+  }
+  if (_ringFd >= 0) {
+    ::close(_ringFd);
+    _ringFd = -1;
+  }
+}
+
+void Uring::_submit(const io_uring_sqe *entries, size_t count) {
+  std::lock_guard<std::mutex> lock(_submitMutex);
+  auto tail = *_sqTail;
+  for (size_t i = 0; i < count; ++i) {
+    auto index = tail++ & _sqMask;
+    _sqes[index] = entries[i];
+    _sqArray[index] = index;
+  }
+  storeRelease(_sqTail, tail);
+
+  // everything queued was consumed by the previous enter, so the queue
+  // never fills up
+  auto toSubmit = static_cast<unsigned>(count);
+  while (toSubmit > 0) {
+    auto submitted = enter(_ringFd, toSubmit, 0, 0);
+    if (submitted < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(),
+                              "io_uring_enter failed");
+    }
+    toSubmit -= static_cast<unsigned>(submitted);
+  }
+}
+
+void Uring::_provideRecycled() {
+  {
+    std::lock_guard<std::mutex> lock(_recycleMutex);
+    _providing.swap(_recycled);
+  }
+  std::sort(_providing.begin(), _providing.end());
+  io_uring_sqe entries[64];
+  size_t count = 0;
+  for (size_t first = 0; first < _providing.size();) {
+    auto last = first + 1;
+    while (last < _providing.size() &&
+           _providing[last] == _providing[last - 1] + 1) {
+      ++last;
+    }
+    entries[count++] =
+        provideBuffers(_buffers, _providing[first], last - first);
+    first = last;
+    if (count == std::size(entries) || first == _providing.size()) {
+      _submit(entries, count);
+      count = 0;
+    }
+  }
+  _providing.clear();
+}
+
+void Uring::_completionLoop() {
+  while (_isRunning) {
+    if (enter(_ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+      std::cerr << "io_uring_enter error: " << strerror(errno) << std::endl;
+      break;
+    }
+
+    auto head = *_cqHead;
+    auto tail = loadAcquire(_cqTail);
+    for (; head != tail; ++head) {
+      const auto &cqe = _cqes[head & _cqMask];
+      // cancellations, link timeouts and provided buffers carry no
+      // operation
+      if (auto *operation = reinterpret_cast<Operation *>(cqe.user_data)) {
+        operation->onComplete(operation->context, cqe.res, cqe.flags);
+      }
+    }
+    storeRelease(_cqHead, head);
+
+    _provideRecycled();
+  }
+}
+} // namespace qabot::uring
+#endif // QABOT_IO_URING
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+
+#include <atomic>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "dns_resolver/dns_resolver.hpp"
+#include "event_manager/event_manager.hpp"
+#include "socket/endpoint.hpp"
+#include "task/task.hpp"
+
+namespace {
+using qabot::dns_resolver::DnsResolver;
+using qabot::socket::Endpoint;
+using qabot::socket::IPVersion;
+
+// A name server with a few A and AAAA records that counts the queries it
+// answers, standing in for getaddrinfo
+class StubNameServer {
+public:
+  std::vector<Endpoint> lookup(const std::string &host, int port,
+                               IPVersion ipVersion) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      ++_queries[host];
+    }
+    if (host != "api.example" && host != "v6.example") {
+      throw std::runtime_error("Failed to resolve " + host);
+    }
+    if (ipVersion == IPVersion::IPv4) {
+      return {v4("10.0.0.1", port), v4("10.0.0.2", port),
+              v4("10.0.0.3", port)};
+    }
+    return {v6("fd00::1", port), v6("fd00::2", port)};
+  }
+
+  int queries(const std::string &host) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _queries[host];
+  }
+
+private:
+  static Endpoint v4(const char *ip, int port) {
+    Endpoint endpoint;
+    auto *address = reinterpret_cast<sockaddr_in *>(&endpoint.address);
+    address->sin_family = AF_INET;
+    address->sin_port = htons(port);
+    inet_pton(AF_INET, ip, &address->sin_addr);
+    endpoint.length = sizeof(sockaddr_in);
+    return endpoint;
+  }
+
+  static Endpoint v6(const char *ip, int port) {
+    Endpoint endpoint;
+    auto *address = reinterpret_cast<sockaddr_in6 *>(&endpoint.address);
+    address->sin6_family = AF_INET6;
+    address->sin6_port = htons(port);
+    inet_pton(AF_INET6, ip, &address->sin6_addr);
+    endpoint.length = sizeof(sockaddr_in6);
+    return endpoint;
+  }
+
+  std::map<std::string, int> _queries;
+  std::mutex _mutex;
+};
+
+StubNameServer nameServer;
+
+// the outcome of one resolve, filled in by the coroutine
+struct Resolution {
+  std::vector<std::string> addresses;
+  std::exception_ptr exceptionPtr = nullptr;
+  std::atomic_bool isDone{false};
+};
+
+qabot::task::DetachedTask resolveInto(std::string host, IPVersion ipVersion,
+                                      Resolution &resolution) {
+  try {
+    auto endpoints =
+        co_await DnsResolver::getInstance().resolve(host, 443, ipVersion);
+    for (const auto &endpoint : endpoints) {
+      resolution.addresses.push_back(endpoint.toString());
+    }
+  } catch (...) {
+    resolution.exceptionPtr = std::current_exception();
+  }
+  resolution.isDone = true;
+  resolution.isDone.notify_one();
+}
+
+// the addresses in the order resolve yields them, rethrows its exception
+std::vector<std::string> resolve(const std::string &host,
+                                 IPVersion ipVersion = IPVersion::IPv4) {
+  Resolution resolution;
+  resolveInto(host, ipVersion, resolution);
+  resolution.isDone.wait(false);
+  if (resolution.exceptionPtr) {
+    std::rethrow_exception(resolution.exceptionPtr);
+  }
+  return resolution.addresses;
+}
+
+class DnsResolverTest : public testing::Test {
+protected:
+  static void SetUpTestSuite() {
+    qabot::event_manager::EventManager::setWorkerCount(1);
+    DnsResolver::setLookupFunction(
+        [](const std::string &host, int port, IPVersion ipVersion) {
+          return nameServer.lookup(host, port, ipVersion);
+        });
+  }
+};
+
+TEST_F(DnsResolverTest, AnswersFromTheCacheAndRotatesTheRecords) {
+  using Addresses = std::vector<std::string>;
+  EXPECT_EQ(resolve("api.example"),
+            (Addresses{"10.0.0.1:443", "10.0.0.2:443", "10.0.0.3:443"}));
+  EXPECT_EQ(resolve("api.example"),
+            (Addresses{"10.0.0.2:443", "10.0.0.3:443", "10.0.0.1:443"}));
+  EXPECT_EQ(resolve("api.example"),
+            (Addresses{"10.0.0.3:443", "10.0.0.1:443", "10.0.0.2:443"}));
+  EXPECT_EQ(resolve("api.example"),
+            (Addresses{"10.0.0.1:443", "10.0.0.2:443", "10.0.0.3:443"}));
+  EXPECT_EQ(nameServer.queries("api.example"), 1);
+}
+
+TEST_F(DnsResolverTest, CachesAaaaRecordsApartFromARecords) {
+  using Addresses = std::vector<std::string>;
+  EXPECT_EQ(resolve("v6.example", IPVersion::IPv6),
+            (Addresses{"[fd00::1]:443", "[fd00::2]:443"}));
+  EXPECT_EQ(resolve("v6.example", IPVersion::IPv6),
+            (Addresses{"[fd00::2]:443", "[fd00::1]:443"}));
+  EXPECT_EQ(nameServer.queries("v6.example"), 1);
+
+  // the A records of the same name are a lookup of their own
+  EXPECT_EQ(resolve("v6.example").size(), 3u);
+  EXPECT_EQ(nameServer.queries("v6.example"), 2);
+  EXPECT_EQ(resolve("v6.example", IPVersion::IPv6),
+            (Addresses{"[fd00::1]:443", "[fd00::2]:443"}));
+  EXPECT_EQ(nameServer.queries("v6.example"), 2);
+}
+
+TEST_F(DnsResolverTest, DoesntCacheFailedLookups) {
+  EXPECT_THROW(resolve("missing.example"), std::runtime_error);
+  EXPECT_THROW(resolve("missing.example"), std::runtime_error);
+  EXPECT_EQ(nameServer.queries("missing.example"), 2);
+}
+} // namespace
@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include <string_view>
+
+#include "http/header_field.hpp"
+
+namespace {
+using qabot::http::ResponseFraming;
+
+TEST(HeaderFieldTest, FramesLowercaseUpstreamHeaders) {
+  ResponseFraming chunked;
+  EXPECT_TRUE(chunked.addHeader("transfer-encoding", "Chunked"));
+  EXPECT_TRUE(chunked.addHeader("connection", "Keep-Alive"));
+  EXPECT_TRUE(chunked.isChunked);
+  EXPECT_FALSE(chunked.isClose);
+
+  ResponseFraming sized;
+  EXPECT_TRUE(sized.addHeader("content-length", " 42 "));
+  EXPECT_TRUE(sized.addHeader("CONNECTION", "CLOSE"));
+  EXPECT_EQ(sized.contentLength, 42u);
+  EXPECT_FALSE(sized.isChunked);
+  EXPECT_TRUE(sized.isClose);
+}
+
+TEST(HeaderFieldTest, FindsTokensInLists) {
+  ResponseFraming framing;
+  EXPECT_TRUE(framing.addHeader("Transfer-Encoding", "gzip, chunked"));
+  EXPECT_TRUE(framing.addHeader("Connection", "keep-alive, close"));
+  EXPECT_TRUE(framing.isChunked);
+  EXPECT_TRUE(framing.isClose);
+
+  EXPECT_TRUE(qabot::http::hasToken("a ,\tb", "B"));
+  EXPECT_FALSE(qabot::http::hasToken("closed", "close"));
+}
+
+TEST(HeaderFieldTest, RejectsContentLengthThatIsNoNumber) {
+  for (std::string_view value : {"12abc", "-1", "", "0x10", "1 2",
+                                 "99999999999999999999999"}) {
+    ResponseFraming framing;
+    EXPECT_FALSE(framing.addHeader("Content-Length", value)) << value;
+  }
+
+  ResponseFraming repeated;
+  EXPECT_TRUE(repeated.addHeader("Content-Length", "5"));
+  EXPECT_TRUE(repeated.addHeader("content-length", "5"));
+  EXPECT_FALSE(repeated.addHeader("Content-Length", "6"));
+}
+} // namespace
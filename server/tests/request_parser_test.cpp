@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "http/request_parser.hpp"
+
+namespace {
+using qabot::http::ParseStatus;
+using qabot::http::RequestParser;
+
+TEST(RequestParserTest, ParsesContentLengthBodyFedByteByByte) {
+  const std::string request = "POST /chat HTTP/1.1\r\n"
+                              "Host: localhost\r\n"
+                              "Content-Length: 5\r\n"
+                              "\r\n"
+                              "hello";
+  RequestParser parser;
+  for (size_t size = 1; size < request.size(); ++size) {
+    ASSERT_EQ(parser.parse(std::string_view(request).substr(0, size)),
+              ParseStatus::Incomplete);
+  }
+  ASSERT_EQ(parser.parse(request), ParseStatus::Complete);
+  EXPECT_EQ(parser.head().path, "/chat");
+  EXPECT_EQ(parser.head().header("host"), "localhost");
+  ASSERT_EQ(parser.bodyParts().size(), 1u);
+  EXPECT_EQ(parser.bodyParts().front(), "hello");
+  EXPECT_EQ(parser.messageSize(), request.size());
+}
+
+TEST(RequestParserTest, LeavesPipelinedRequestForTheNextParse) {
+  const std::string first = "GET /metrics HTTP/1.1\r\n\r\n";
+  const std::string second = "GET /other HTTP/1.1\r\nConnection: close\r\n\r\n";
+  const std::string data = first + second;
+
+  RequestParser parser;
+  ASSERT_EQ(parser.parse(data), ParseStatus::Complete);
+  EXPECT_EQ(parser.head().path, "/metrics");
+  EXPECT_TRUE(parser.head().keepAlive());
+  ASSERT_EQ(parser.messageSize(), first.size());
+
+  parser.reset();
+  ASSERT_EQ(parser.parse(std::string_view(data).substr(first.size())),
+            ParseStatus::Complete);
+  EXPECT_EQ(parser.head().path, "/other");
+  EXPECT_FALSE(parser.head().keepAlive());
+}
+
+TEST(RequestParserTest, ParsesChunkedBody) {
+  const std::string request = "POST /chat HTTP/1.1\r\n"
+                              "Transfer-Encoding: chunked\r\n"
+                              "\r\n"
+                              "5\r\nhello\r\n"
+                              "6;ext=1\r\n world\r\n"
+                              "0\r\n"
+                              "\r\n";
+  RequestParser parser;
+  ASSERT_EQ(parser.parse(request), ParseStatus::Complete);
+  ASSERT_EQ(parser.bodyParts().size(), 2u);
+  EXPECT_EQ(parser.bodyParts()[0], "hello");
+  EXPECT_EQ(parser.bodyParts()[1], " world");
+  EXPECT_EQ(parser.bodySize(), 11u);
+}
+
+TEST(RequestParserTest, RejectsChunkSizeAboveTheLimit) {
+  const std::string request = "POST /chat HTTP/1.1\r\n"
+                              "Transfer-Encoding: chunked\r\n"
+                              "\r\n"
+                              "fffffffffffffffe\r\n"
+                              "hello\r\n";
+  RequestParser parser(1024 * 1024);
+  EXPECT_THROW(parser.parse(request), std::runtime_error);
+}
+
+TEST(RequestParserTest, KeepsWaitingForHugeChunkWithoutLimit) {
+  const std::string request = "POST /chat HTTP/1.1\r\n"
+                              "Transfer-Encoding: chunked\r\n"
+                              "\r\n"
+                              "fffffffffffffffe\r\n"
+                              "hello\r\n";
+  RequestParser parser(RequestParser::kUnlimited);
+  EXPECT_EQ(parser.parse(request), ParseStatus::Incomplete);
+  EXPECT_TRUE(parser.bodyParts().empty());
+}
+
+TEST(RequestParserTest, RejectsBodiesAboveTheLimit) {
+  RequestParser contentLength(4);
+  EXPECT_THROW(contentLength.parse("POST / HTTP/1.1\r\n"
+                                   "Content-Length: 5\r\n\r\n"),
+               std::runtime_error);
+
+  // the sum of the chunks counts, not each chunk on its own
+  RequestParser chunked(4);
+  EXPECT_THROW(chunked.parse("POST / HTTP/1.1\r\n"
+                             "Transfer-Encoding: chunked\r\n\r\n"
+                             "3\r\nabc\r\n"
+                             "2\r\nde\r\n"),
+               std::runtime_error);
+}
+} // namespace
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string_view>
+
+#include "buffered_reader/buffered_reader.hpp"
+#include "event_manager/event_manager.hpp"
+#include "socket/socket.hpp"
+#include "socket/unix_socket_impl.hpp"
+#include "task/task.hpp"
+#include "write_queue/write_queue.hpp"
+
+// GCC inlines the replaced operator delete into callers of new and then
+// takes the free in it for a mismatch
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// every heap allocation of the process, on any thread
+namespace {
+std::atomic_size_t allocationCount{0};
+} // namespace
+
+void *operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (auto *memory = std::malloc(size ? size : 1)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  auto align = static_cast<size_t>(alignment);
+  if (auto *memory = std::aligned_alloc(align, (size + align - 1) / align *
+                                                   align)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+void operator delete(void *memory, std::align_val_t) noexcept {
+  std::free(memory);
+}
+void operator delete(void *memory, size_t, std::align_val_t) noexcept {
+  std::free(memory);
+}
+
+namespace {
+using Connection = qabot::socket::Socket<qabot::socket::UnixSocketImpl>;
+
+// Echoes whatever arrives until the peer closes. Every message suspends the
+// coroutine in the reactor and resumes it on the event loop, like a client
+// connection between two requests.
+qabot::task::DetachedTask echo(Connection &connection,
+                               std::atomic_bool &isDone) {
+  qabot::buffered_reader::BufferedReader reader(connection);
+  qabot::write_queue::WriteQueue writer(connection);
+  while (true) {
+    auto data = co_await reader.readSome();
+    if (data.empty()) {
+      break;
+    }
+    co_await writer.asyncWriteAll(data);
+  }
+  isDone = true;
+  isDone.notify_one();
+}
+
+void roundTrip(int peer) {
+  constexpr std::string_view kMessage = "ping";
+  ASSERT_EQ(::send(peer, kMessage.data(), kMessage.size(), 0),
+            static_cast<ssize_t>(kMessage.size()));
+  char reply[kMessage.size()];
+  size_t received = 0;
+  while (received < sizeof(reply)) {
+    auto bytes = ::recv(peer, reply + received, sizeof(reply) - received, 0);
+    ASSERT_GT(bytes, 0);
+    received += bytes;
+  }
+}
+
+TEST(SchedulingAllocationTest, SteadyStateResumesDontAllocate) {
+  // a single worker, so the coroutine and its pooled buffers stay on one
+  // thread
+  qabot::event_manager::EventManager::setWorkerCount(1);
+
+  int fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  qabot::socket::UnixSocketImpl impl(fds[0],
+                                     qabot::socket::TransportProtocol::TCP,
+                                     qabot::socket::IPVersion::IPv4);
+  Connection connection(impl);
+  int peer = fds[1];
+
+  std::atomic_bool isDone{false};
+  echo(connection, isDone);
+
+  // first uses set up the reactor entry, the pool's free lists and the
+  // singletons
+  for (int i = 0; i < 100; ++i) {
+    roundTrip(peer);
+  }
+
+  auto before = allocationCount.load();
+  for (int i = 0; i < 10000; ++i) {
+    roundTrip(peer);
+  }
+  EXPECT_EQ(allocationCount.load() - before, 0u);
+
+  ::close(peer);
+  isDone.wait(false);
+}
+} // namespace
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "awaitable/awaitable.hpp"
+#include "event_manager/event_manager.hpp"
+#include "reactor/reactor.hpp"
+#include "task/task.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+using qabot::event_manager::EventManager;
+using qabot::reactor::Clock;
+
+// where and when a sleep started and ended, filled in by the coroutine
+struct SleepReport {
+  size_t workerBefore = 0;
+  size_t workerAfter = 0;
+  Clock::time_point deadline;
+  Clock::time_point resumedAt;
+  std::atomic_bool isDone{false};
+};
+
+qabot::task::DetachedTask sleepOn(size_t workerIndex,
+                                  Clock::duration duration,
+                                  SleepReport &report) {
+  co_await qabot::awaitable::resumeOn(workerIndex);
+  report.workerBefore = EventManager::currentWorker();
+  report.deadline = Clock::now() + duration;
+  co_await qabot::awaitable::sleepUntil(report.deadline);
+  report.resumedAt = Clock::now();
+  report.workerAfter = EventManager::currentWorker();
+  report.isDone = true;
+  report.isDone.notify_one();
+}
+
+qabot::task::Task<void> sleepThenMark(Clock::duration duration,
+                                      std::atomic_bool &isResumed) {
+  co_await qabot::awaitable::sleepFor(duration);
+  isResumed = true;
+}
+
+class SleepTest : public testing::Test {
+protected:
+  static void SetUpTestSuite() {
+    EventManager::setWorkerCount(2);
+    // unpinned workers steal each other's events
+    EventManager::setPinned(true);
+  }
+};
+
+TEST_F(SleepTest, ResumesAfterTheDeadlineOnTheSameWorker) {
+  for (size_t worker = 0; worker < 2; ++worker) {
+    SleepReport report;
+    sleepOn(worker, 20ms, report);
+    report.isDone.wait(false);
+    EXPECT_EQ(report.workerBefore, worker);
+    EXPECT_EQ(report.workerAfter, worker);
+    EXPECT_GE(report.resumedAt, report.deadline);
+  }
+}
+
+TEST_F(SleepTest, DestroyingASleepingCoroutineCancelsItsTimer) {
+  std::atomic_bool isResumed{false};
+  {
+    auto sleeper = sleepThenMark(50ms, isResumed);
+    EXPECT_FALSE(sleeper.isDone());
+    // the frame and its Sleep go away here, the timer with them
+  }
+  std::this_thread::sleep_for(150ms);
+  EXPECT_FALSE(isResumed);
+}
+} // namespace